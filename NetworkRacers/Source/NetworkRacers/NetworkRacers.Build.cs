@@ -8,8 +8,17 @@ public class NetworkRacers : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "PhysXVehicles", "HeadMountedDisplay" });
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "PhysXVehicles", "Sockets", "Networking" });
 
-		PublicDefinitions.Add("HMD_MODULE_INCLUDED=1");
+		// Dedicated servers have no headset to track, so leave the HMD module out of the server build entirely.
+		if (Target.Type != TargetType.Server)
+		{
+			PublicDependencyModuleNames.Add("HeadMountedDisplay");
+			PublicDefinitions.Add("HMD_MODULE_INCLUDED=1");
+		}
+		else
+		{
+			PublicDefinitions.Add("HMD_MODULE_INCLUDED=0");
+		}
 	}
 }
@@ -0,0 +1,65 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "NetworkRacersGameInstance.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+#include "Misc/PackageName.h"
+#include "UObject/UObjectGlobals.h"
+
+void UNetworkRacersGameInstance::Init()
+{
+	Super::Init();
+
+	FCoreUObjectDelegates::PreLoadMap.AddUObject(this, &UNetworkRacersGameInstance::OnPreLoadMap);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UNetworkRacersGameInstance::OnPostLoadMap);
+}
+
+void UNetworkRacersGameInstance::Shutdown()
+{
+	FCoreUObjectDelegates::PreLoadMap.RemoveAll(this);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+
+	ActivePreloadHandles.Empty();
+	PendingPreloadHandles.Empty();
+
+	Super::Shutdown();
+}
+
+void UNetworkRacersGameInstance::OnPreLoadMap(const FString& MapName)
+{
+	const FString ShortMapName = FPackageName::GetShortName(MapName);
+	const FNetworkRacersMapPreload* Preload = MapPreloads.FindByPredicate([&ShortMapName](const FNetworkRacersMapPreload& Entry)
+	{
+		return Entry.MapName == ShortMapName;
+	});
+	if (Preload == nullptr)
+	{
+		return;
+	}
+
+	// Dedicated servers never draw anything, so they don't need materials, fonts or animation.
+	TArray<FSoftObjectPath> AssetsToLoad = Preload->Assets;
+	if (!IsDedicatedServerInstance())
+	{
+		AssetsToLoad.Append(Preload->CosmeticAssets);
+	}
+	if (AssetsToLoad.Num() == 0)
+	{
+		return;
+	}
+
+	// Start streaming now so the assets arrive during the loading screen rather than when the first pawn spawns.
+	FStreamableManager& Streamable = UAssetManager::GetStreamableManager();
+	TSharedPtr<FStreamableHandle> Handle = Streamable.RequestAsyncLoad(AssetsToLoad, FStreamableDelegate(), FStreamableManager::AsyncLoadHighPriority);
+	if (Handle.IsValid())
+	{
+		PendingPreloadHandles.Add(Handle);
+	}
+}
+
+void UNetworkRacersGameInstance::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	// Only now can the previous map's assets be let go, since the new map may share them.
+	ActivePreloadHandles = MoveTemp(PendingPreloadHandles);
+	PendingPreloadHandles.Reset();
+}
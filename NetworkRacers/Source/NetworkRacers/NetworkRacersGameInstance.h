@@ -0,0 +1,54 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+#pragma once
+#include "Engine/GameInstance.h"
+#include "NetworkRacersGameInstance.generated.h"
+
+struct FStreamableHandle;
+
+/** Assets to stream in while a map is loading */
+USTRUCT()
+struct FNetworkRacersMapPreload
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** Short name of the map this entry applies to, eg. VehicleExampleMap */
+	UPROPERTY(Config)
+	FString MapName;
+
+	/** Assets needed by every net mode, eg. meshes the vehicle simulation depends on */
+	UPROPERTY(Config)
+	TArray<FSoftObjectPath> Assets;
+
+	/** Assets only needed to draw the game. Dedicated servers skip these. */
+	UPROPERTY(Config)
+	TArray<FSoftObjectPath> CosmeticAssets;
+
+};
+
+UCLASS(config = Game)
+class UNetworkRacersGameInstance : public UGameInstance
+{
+	GENERATED_BODY()
+
+public:
+	// Begin UGameInstance interface
+	virtual void Init() override;
+	virtual void Shutdown() override;
+	// End UGameInstance interface
+
+private:
+	void OnPreLoadMap(const FString& MapName);
+
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	/** Preload manifest, one entry per map */
+	UPROPERTY(Config)
+	TArray<FNetworkRacersMapPreload> MapPreloads;
+
+	/** Handles keeping the current map's preloaded assets resident */
+	TArray<TSharedPtr<FStreamableHandle>> ActivePreloadHandles;
+
+	/** Handles for the map currently being loaded. They replace ActivePreloadHandles once it has loaded. */
+	TArray<TSharedPtr<FStreamableHandle>> PendingPreloadHandles;
+
+};
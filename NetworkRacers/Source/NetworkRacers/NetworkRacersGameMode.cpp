@@ -3,28 +3,498 @@
 #include "NetworkRacersGameMode.h"
 #include "NetworkRacersPawn.h"
 #include "NetworkRacersHud.h"
+#include "NetworkRacersPlayerController.h"
 #include "Engine/World.h"
 #include "GameFramework/DefaultPawn.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/LevelStreamingKismet.h"
+#include "Kismet/GameplayStatics.h"
+#include "Vehicle/GoKartMovementInterface.h"
+#include "Vehicle/GoKartMovementReplicator.h"
+#include "Vehicle/GoKartSnapshotStream.h"
+#include "Vehicle/GoKartSpectatorFeed.h"
+#include "Vehicle/GoKartClockSync.h"
+#include "Vehicle/GoKartAIManager.h"
+#include "Vehicle/GoKart.h"
+#include "TimerManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
 
 ANetworkRacersGameMode::ANetworkRacersGameMode()
 {
 	DefaultPawnClass = ANetworkRacersPawn::StaticClass();
 	HUDClass = ANetworkRacersHud::StaticClass();
+	PlayerControllerClass = ANetworkRacersPlayerController::StaticClass();
+	BotPawnClass = AGoKart::StaticClass();
+
+}
+
+void ANetworkRacersGameMode::InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage)
+{
+	Super::InitGame(MapName, Options, ErrorMessage);
+
+	// Spectators watch the relay's stream locally rather than joining the race server, so they don't get a kart.
+	if (GetNetMode() == NM_Standalone && FParse::Value(FCommandLine::Get(), TEXT("SpectatorRelay="), SpectateRelayAddress))
+	{
+		bStartPlayersAsSpectators = true;
+	}
+
+	// Every race but the first needs its own copy of the track, otherwise its karts would drive on nothing.
+	if (MaxRaceInstances > 1 && RaceInstanceLevel.IsEmpty())
+	{
+		UE_LOG(LogGameMode, Error, TEXT("InitGame: MaxRaceInstances is %d but RaceInstanceLevel isn't set, so only one race can have a track. Hosting a single race."), MaxRaceInstances);
+		MaxRaceInstances = 1;
+	}
+
+	// Sized once, since snapshot streams point at the races' snapshots.
+	RaceInstances.SetNum(FMath::Max(MaxRaceInstances, 0));
+
+}
+
+void ANetworkRacersGameMode::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!SpectateRelayAddress.IsEmpty())
+	{
+		AGoKartSpectatorFeed* Feed = GetWorld()->SpawnActor<AGoKartSpectatorFeed>();
+		if (Feed != nullptr)
+		{
+			Feed->Connect(SpectateRelayAddress);
+		}
+		return;
+	}
+
+	if (GetNetMode() != NM_Standalone && !SpectatorRelayAddress.IsEmpty() && SpectatorBroadcastRate > 0.f && SpectatorBroadcaster.Start(SpectatorRelayAddress))
+	{
+		GetWorldTimerManager().SetTimer(SpectatorBroadcastTimer, this, &ANetworkRacersGameMode::BroadcastToSpectators, 1.f / SpectatorBroadcastRate, true);
+	}
+
+	if (MaxBotsPerRace > 0 && BotPawnClass != nullptr)
+	{
+		AIManager = GetWorld()->SpawnActor<AGoKartAIManager>();
+
+		// A listen server's own player joined before play began.
+		for (int32 Index = 0; Index < RaceInstances.Num(); ++Index)
+		{
+			UpdateBots(Index);
+		}
+	}
+
+	// Pre-warm the pool while the map is loading so players joining or respawning don't pay for pawn construction. See RestartPlayer and RespawnPawn.
+	UClass* PawnClass = GetDefaultPawnClassForController(nullptr);
+	for (int32 Index = 0; Index < PawnPoolSize; ++Index)
+	{
+		APawn* Pawn = SpawnPooledPawn(PawnClass, FTransform::Identity);
+		if (Pawn != nullptr)
+		{
+			DeactivatePawn(Pawn);
+			PooledPawns.Add(Pawn);
+		}
+	}
+
+}
+
+void ANetworkRacersGameMode::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorldTimerManager().ClearTimer(SpectatorBroadcastTimer);
+	SpectatorBroadcaster.Stop();
+
+	Super::EndPlay(EndPlayReason);
+
+}
+
+void ANetworkRacersGameMode::BroadcastToSpectators()
+{
+	if (FGoKartSnapshot* Snapshot = GetKartSnapshot(SpectatedRaceInstance))
+	{
+		SpectatorBroadcaster.Broadcast(*Snapshot, GoKartTime::GetSessionTicks());
+	}
 
 }
 
 APawn* ANetworkRacersGameMode::SpawnDefaultPawnAtTransform_Implementation(AController* NewPlayer, const FTransform& SpawnTransform)
 {
+	// Player starts are in the persistent level, so move the spawn onto the player's copy of the track.
+	const int32 RaceInstanceId = GetRaceInstanceId(NewPlayer);
+	FTransform RaceSpawnTransform = SpawnTransform;
+	if (RaceInstances.IsValidIndex(RaceInstanceId))
+	{
+		RaceSpawnTransform.AddToTranslation(RaceInstances[RaceInstanceId].Origin);
+	}
+
+	UClass* PawnClass = GetDefaultPawnClassForController(NewPlayer);
+	APawn* ResultPawn = AcquirePawn(PawnClass, RaceSpawnTransform);
+	if (!ResultPawn)
+	{
+		ResultPawn = SpawnPooledPawn(PawnClass, RaceSpawnTransform);
+	}
+	if (!ResultPawn)
+	{
+		UE_LOG(LogGameMode, Warning, TEXT("SpawnDefaultPawnAtTransform: Couldn't spawn Pawn of type %s at %s"), *GetNameSafe(PawnClass), *RaceSpawnTransform.ToHumanReadableString());
+	}
+	else if (UGoKartMovementReplicator* MovementReplicator = ResultPawn->FindComponentByClass<UGoKartMovementReplicator>())
+	{
+		MovementReplicator->SetRaceInstanceId(RaceInstanceId);
+	}
+	return ResultPawn;
+
+}
+
+void ANetworkRacersGameMode::Logout(AController* Exiting)
+{
+	// Take the pawn back before the controller is cleaned up, otherwise it is destroyed along with it.
+	if (Exiting != nullptr)
+	{
+		ReleasePawn(Exiting->GetPawn());
+	}
+
+	for (int32 Index = 0; Index < RaceInstances.Num(); ++Index)
+	{
+		if (RaceInstances[Index].Players.Remove(Exiting) > 0)
+		{
+			UpdateBots(Index);
+		}
+	}
+
+	for (int32 Index = SnapshotStreams.Num() - 1; Index >= 0; --Index)
+	{
+		AGoKartSnapshotStream* Stream = SnapshotStreams[Index];
+		if (Stream == nullptr || Stream->GetOwner() == Exiting)
+		{
+			if (Stream != nullptr)
+			{
+				Stream->Destroy();
+			}
+			SnapshotStreams.RemoveAtSwap(Index);
+		}
+	}
+
+	Super::Logout(Exiting);
+
+}
+
+void ANetworkRacersGameMode::RestartPlayer(AController* NewPlayer)
+{
+	// A player respawning gets a pawn from the pool at a start, and the one they had goes back into it.
+	if (NewPlayer != nullptr && NewPlayer->GetPawn() != nullptr)
+	{
+		ReleasePawn(NewPlayer->GetPawn());
+	}
+
+	Super::RestartPlayer(NewPlayer);
+
+}
+
+void ANetworkRacersGameMode::RespawnPawn(APawn* Pawn)
+{
+	if (Pawn == nullptr) return;
+
+	for (int32 Index = 0; Index < RaceInstances.Num(); ++Index)
+	{
+		if (RaceInstances[Index].Bots.Remove(Pawn) > 0)
+		{
+			if (AIManager != nullptr)
+			{
+				AIManager->RemoveBot(Pawn);
+			}
+			ReleasePawn(Pawn);
+			UpdateBots(Index);
+			return;
+		}
+	}
+
+	AController* Controller = Pawn->GetController();
+	ReleasePawn(Pawn);
+	if (Controller != nullptr)
+	{
+		RestartPlayer(Controller);
+	}
+
+}
+
+void ANetworkRacersGameMode::PostLogin(APlayerController* NewPlayer)
+{
+	// Joining an empty race costs nothing, so only stream when there are karts to catch up on. Local players see the server's world directly.
+	FGoKartSnapshot* Snapshot = GetKartSnapshot(GetRaceInstanceId(NewPlayer));
+	if (NewPlayer != nullptr && !NewPlayer->IsLocalController() && Snapshot != nullptr && Snapshot->GetNumKarts() > 0)
+	{
+		FActorSpawnParameters SpawnInfo;
+		SpawnInfo.Owner = NewPlayer;
+		if (AGoKartSnapshotStream* Stream = GetWorld()->SpawnActor<AGoKartSnapshotStream>(SpawnInfo))
+		{
+			Stream->StartStreaming(Snapshot);
+			SnapshotStreams.Add(Stream);
+		}
+	}
+
+	Super::PostLogin(NewPlayer);
+
+}
+
+FString ANetworkRacersGameMode::InitNewPlayer(APlayerController* NewPlayerController, const FUniqueNetIdRepl& UniqueId, const FString& Options, const FString& Portal)
+{
+	AssignRaceInstance(NewPlayerController, UGameplayStatics::GetIntOption(Options, TEXT("Race"), INDEX_NONE));
+
+	return Super::InitNewPlayer(NewPlayerController, UniqueId, Options, Portal);
+
+}
+
+void ANetworkRacersGameMode::AssignRaceInstance(APlayerController* Player, int32 PreferredInstanceId)
+{
+	if (Player == nullptr || RaceInstances.Num() == 0) return;
+
+	// The race asked for if it has room, otherwise the first with room, otherwise the least full.
+	int32 InstanceId = INDEX_NONE;
+	if (RaceInstances.IsValidIndex(PreferredInstanceId) && RaceInstances[PreferredInstanceId].Players.Num() < MaxPlayersPerRace)
+	{
+		InstanceId = PreferredInstanceId;
+	}
+	for (int32 Index = 0; InstanceId == INDEX_NONE && Index < RaceInstances.Num(); ++Index)
+	{
+		if (RaceInstances[Index].Players.Num() < MaxPlayersPerRace)
+		{
+			InstanceId = Index;
+		}
+	}
+	if (InstanceId == INDEX_NONE)
+	{
+		InstanceId = 0;
+		for (int32 Index = 1; Index < RaceInstances.Num(); ++Index)
+		{
+			if (RaceInstances[Index].Players.Num() < RaceInstances[InstanceId].Players.Num())
+			{
+				InstanceId = Index;
+			}
+		}
+	}
+
+	FNetworkRacersRaceInstance& RaceInstance = RaceInstances[InstanceId];
+	RaceInstance.Origin = FVector((InstanceId % 4) * RaceInstanceSpacing, (InstanceId / 4) * RaceInstanceSpacing, 0.f);
+	RaceInstance.Players.AddUnique(Player);
+
+	// Tracks are instanced when a race first gets a player and kept afterwards, so a race that empties can be refilled without reloading.
+	const bool bNeedsTrackInstance = InstanceId > 0 && !RaceInstanceLevel.IsEmpty();
+	if (bNeedsTrackInstance && RaceInstance.Level == nullptr)
+	{
+		bool bSuccess = false;
+		RaceInstance.Level = ULevelStreamingKismet::LoadLevelInstance(this, RaceInstanceLevel, RaceInstance.Origin, FRotator::ZeroRotator, bSuccess);
+		if (!bSuccess)
+		{
+			UE_LOG(LogGameMode, Warning, TEXT("AssignRaceInstance: Couldn't load track %s for race %d"), *RaceInstanceLevel, InstanceId);
+		}
+	}
+
+	if (ANetworkRacersPlayerController* RacersController = Cast<ANetworkRacersPlayerController>(Player))
+	{
+		RacersController->SetRaceInstance(InstanceId, RaceInstance.Origin, bNeedsTrackInstance ? RaceInstanceLevel : FString());
+	}
+
+	UpdateBots(InstanceId);
+
+}
+
+void ANetworkRacersGameMode::UpdateBots(int32 RaceInstanceId)
+{
+	if (AIManager == nullptr || !RaceInstances.IsValidIndex(RaceInstanceId) || !AIManager->HasRacingLine()) return;
+
+	FNetworkRacersRaceInstance& RaceInstance = RaceInstances[RaceInstanceId];
+	const int32 NumPlayers = RaceInstance.Players.Num();
+	const int32 NumBots = NumPlayers > 0 ? FMath::Clamp(MaxPlayersPerRace - NumPlayers, 0, MaxBotsPerRace) : 0;
+
+	// Bots leave newest first, so the ones that have been racing longest stay.
+	while (RaceInstance.Bots.Num() > NumBots)
+	{
+		APawn* Bot = RaceInstance.Bots.Pop();
+		AIManager->RemoveBot(Bot);
+		ReleasePawn(Bot);
+	}
+
+	while (RaceInstance.Bots.Num() < NumBots)
+	{
+		const FTransform SpawnTransform = AIManager->GetStartTransform(RaceInstance.Bots.Num(), RaceInstance.Origin);
+		APawn* Bot = AcquirePawn(BotPawnClass, SpawnTransform);
+		if (!Bot)
+		{
+			Bot = SpawnPooledPawn(BotPawnClass, SpawnTransform);
+		}
+		if (!Bot || !AIManager->AddBot(Bot, RaceInstance.Origin))
+		{
+			UE_LOG(LogGameMode, Warning, TEXT("UpdateBots: Couldn't add a bot of type %s to race %d"), *GetNameSafe(BotPawnClass), RaceInstanceId);
+			ReleasePawn(Bot);
+			break;
+		}
+
+		if (UGoKartMovementReplicator* MovementReplicator = Bot->FindComponentByClass<UGoKartMovementReplicator>())
+		{
+			MovementReplicator->SetRaceInstanceId(RaceInstanceId);
+		}
+		RaceInstance.Bots.Add(Bot);
+	}
+
+}
+
+int32 ANetworkRacersGameMode::GetRaceInstanceId(const AActor* Viewer) const
+{
+	for (int32 Index = 0; Index < RaceInstances.Num(); ++Index)
+	{
+		if (RaceInstances[Index].Players.Contains(Viewer))
+		{
+			return Index;
+		}
+	}
+
+	return INDEX_NONE;
+
+}
+
+bool ANetworkRacersGameMode::IsKartAdmittedFor(int32 KartId, int32 RaceInstanceId, const AActor* Viewer) const
+{
+	// Karts that aren't racing (eg. parked in the pool) and viewers that aren't in a race see everything.
+	if (RaceInstanceId != INDEX_NONE)
+	{
+		const int32 ViewerRaceInstanceId = GetRaceInstanceId(Viewer);
+		if (ViewerRaceInstanceId != INDEX_NONE && ViewerRaceInstanceId != RaceInstanceId)
+		{
+			return false;
+		}
+	}
+
+	for (const AGoKartSnapshotStream* Stream : SnapshotStreams)
+	{
+		if (Stream != nullptr && Stream->GetOwner() == Viewer)
+		{
+			return Stream->IsKartAdmitted(KartId);
+		}
+	}
+
+	return true;
+
+}
+
+void ANetworkRacersGameMode::ReleasePawn(APawn* Pawn)
+{
+	if (Pawn == nullptr || Pawn->IsPendingKillPending()) return;
+
+	if (AController* Controller = Pawn->GetController())
+	{
+		Controller->UnPossess();
+	}
+
+	if (UGoKartMovementReplicator* MovementReplicator = Pawn->FindComponentByClass<UGoKartMovementReplicator>())
+	{
+		MovementReplicator->SetRaceInstanceId(INDEX_NONE);
+
+		// Pooled pawns never end play, so their driver's stats are handed over here.
+		MovementReplicator->SubmitNetStats();
+	}
+
+	DeactivatePawn(Pawn);
+	PooledPawns.AddUnique(Pawn);
+
+}
+
+APawn* ANetworkRacersGameMode::SpawnPooledPawn(UClass* PawnClass, const FTransform& SpawnTransform)
+{
+	if (PawnClass == nullptr) return nullptr;
+
 	FActorSpawnParameters SpawnInfo;
 	SpawnInfo.Instigator = Instigator;
 	SpawnInfo.ObjectFlags |= RF_Transient;	// We never want to save default player pawns into a map
 	SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn; // Always spawn even if colliding
-	UClass* PawnClass = GetDefaultPawnClassForController(NewPlayer);
-	APawn* ResultPawn = GetWorld()->SpawnActor<APawn>(PawnClass, SpawnTransform, SpawnInfo);
-	if (!ResultPawn)
+	return GetWorld()->SpawnActor<APawn>(PawnClass, SpawnTransform, SpawnInfo);
+
+}
+
+APawn* ANetworkRacersGameMode::AcquirePawn(UClass* PawnClass, const FTransform& SpawnTransform)
+{
+	for (int32 Index = PooledPawns.Num() - 1; Index >= 0; --Index)
 	{
-		UE_LOG(LogGameMode, Warning, TEXT("SpawnDefaultPawnAtTransform: Couldn't spawn Pawn of type %s at %s"), *GetNameSafe(PawnClass), *SpawnTransform.ToHumanReadableString());
+		APawn* Pawn = PooledPawns[Index];
+		if (Pawn == nullptr || Pawn->IsPendingKillPending())
+		{
+			PooledPawns.RemoveAtSwap(Index);
+			continue;
+		}
+		if (Pawn->GetClass() == PawnClass)
+		{
+			PooledPawns.RemoveAtSwap(Index);
+			ActivatePawn(Pawn, SpawnTransform);
+			return Pawn;
+		}
 	}
-	return ResultPawn;
+
+	return nullptr;
+
+}
+
+void ANetworkRacersGameMode::DeactivatePawn(APawn* Pawn)
+{
+	Pawn->SetActorHiddenInGame(true);
+	Pawn->SetActorEnableCollision(false);
+	Pawn->SetActorTickEnabled(false);
+
+	// Stop ticking components too, otherwise the movement components keep simulating a parked pawn.
+	for (UActorComponent* Component : Pawn->GetComponents())
+	{
+		Component->SetComponentTickEnabled(false);
+	}
+
+	if (UPrimitiveComponent* Root = Cast<UPrimitiveComponent>(Pawn->GetRootComponent()))
+	{
+		Root->SetSimulatePhysics(false);
+	}
+
+	// Nothing about a parked pawn changes, so clients don't need updates for it.
+	Pawn->SetNetDormancy(DORM_DormantAll);
+
+}
+
+void ANetworkRacersGameMode::ActivatePawn(APawn* Pawn, const FTransform& SpawnTransform)
+{
+	Pawn->SetActorTransform(SpawnTransform, false, nullptr, ETeleportType::TeleportPhysics);
+
+	// Clear any velocity left over from the pawn's previous life.
+	if (UPawnMovementComponent* PawnMovement = Pawn->GetMovementComponent())
+	{
+		PawnMovement->StopMovementImmediately();
+	}
+	for (UActorComponent* Component : Pawn->GetComponentsByInterface(UGoKartMovementInterface::StaticClass()))
+	{
+		CastChecked<IGoKartMovementInterface>(Component)->ResetMovement();
+	}
+	if (UGoKartMovementReplicator* MovementReplicator = Pawn->FindComponentByClass<UGoKartMovementReplicator>())
+	{
+		MovementReplicator->ResetServerInput();
+	}
+
+	for (UActorComponent* Component : Pawn->GetComponents())
+	{
+		if (Component->PrimaryComponentTick.bStartWithTickEnabled)
+		{
+			Component->SetComponentTickEnabled(true);
+		}
+	}
+
+	if (UPrimitiveComponent* Root = Cast<UPrimitiveComponent>(Pawn->GetRootComponent()))
+	{
+		// Only pawns that simulated physics when spawned (eg. the PhysX vehicle) go back to simulating.
+		const UPrimitiveComponent* DefaultRoot = Cast<UPrimitiveComponent>(Pawn->GetClass()->GetDefaultObject<APawn>()->GetRootComponent());
+		if (DefaultRoot != nullptr && DefaultRoot->BodyInstance.bSimulatePhysics)
+		{
+			Root->SetSimulatePhysics(true);
+			Root->SetPhysicsLinearVelocity(FVector::ZeroVector);
+			Root->SetPhysicsAngularVelocityInDegrees(FVector::ZeroVector);
+		}
+	}
+
+	Pawn->SetActorHiddenInGame(false);
+	Pawn->SetActorEnableCollision(true);
+	Pawn->SetActorTickEnabled(true);
+
+	Pawn->SetNetDormancy(DORM_Awake);
+	Pawn->ForceNetUpdate();
 
 }
@@ -1,8 +1,40 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 #pragma once
 #include "GameFramework/GameModeBase.h"
+#include "Vehicle/GoKartSnapshot.h"
+#include "Vehicle/GoKartSpectatorStream.h"
 #include "NetworkRacersGameMode.generated.h"
 
+class AGoKartSnapshotStream;
+class AGoKartAIManager;
+class ULevelStreaming;
+
+/** One of the independent races hosted by this server, see ANetworkRacersGameMode::MaxRaceInstances */
+USTRUCT()
+struct FNetworkRacersRaceInstance
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** Where the race's copy of the track is, everything in the race is offset by this */
+	UPROPERTY()
+	FVector Origin = FVector::ZeroVector;
+
+	UPROPERTY()
+	TArray<AController*> Players;
+
+	/** Server's instance of the track, null for the race that uses the persistent level */
+	UPROPERTY()
+	ULevelStreaming* Level = nullptr;
+
+	/** Karts driven by the server in the race's empty slots */
+	UPROPERTY()
+	TArray<APawn*> Bots;
+
+	/** Snapshot of the race's karts, kept up to date by their movement replicators. KartIds are only unique within a race. */
+	FGoKartSnapshot KartSnapshot;
+
+};
+
 UCLASS(minimalapi)
 class ANetworkRacersGameMode : public AGameModeBase
 {
@@ -14,4 +46,125 @@ public:
 	// Overriding this function from AGameModeBase to adjust SpawnInfo.SpawnCollisionHandlingOverride.
 	APawn* SpawnDefaultPawnAtTransform_Implementation(AController* NewPlayer, const FTransform& SpawnTransform);
 
+	// Overriding this function from AGameModeBase to return the exiting player's pawn to the pool instead of destroying it.
+	virtual void Logout(AController* Exiting) override;
+
+	/** Unpossess a pawn and park it in the pool so a later (re)spawn can reuse it. */
+	void ReleasePawn(APawn* Pawn);
+
+	// Overriding this function from AGameModeBase to return the player's current pawn to the pool before they get a new one.
+	virtual void RestartPlayer(AController* NewPlayer) override;
+
+	/** Replace a pawn that is out of the race (eg. fell out of the world) with one from the pool, for its player or bot slot. */
+	void RespawnPawn(APawn* Pawn);
+
+	// Overriding this function from AGameModeBase to stream the kart snapshot to players joining mid-race.
+	virtual void PostLogin(APlayerController* NewPlayer) override;
+
+	// Overriding this function from AGameModeBase to place the player in a race instance, optionally the one asked for with ?Race=N.
+	virtual FString InitNewPlayer(APlayerController* NewPlayerController, const FUniqueNetIdRepl& UniqueId, const FString& Options, const FString& Portal = TEXT("")) override;
+
+	/** Race instance Viewer (a controller) is in, INDEX_NONE if it isn't in one */
+	int32 GetRaceInstanceId(const AActor* Viewer) const;
+
+	// Overriding this function from AGameModeBase to start as a spectator of the relay given with -SpectatorRelay=host:port,
+	// and to set up the race instances.
+	virtual void InitGame(const FString& MapName, const FString& Options, FString& ErrorMessage) override;
+
+	/** Snapshot of the race instance's karts, null if there is no such race */
+	FGoKartSnapshot* GetKartSnapshot(int32 RaceInstanceId) { return RaceInstances.IsValidIndex(RaceInstanceId) ? &RaceInstances[RaceInstanceId].KartSnapshot : nullptr; }
+
+	/**
+	 * Whether a kart may be replicated to Viewer. Karts are only replicated within their race instance,
+	 * and are admitted to players joining mid-race a few at a time.
+	 */
+	bool IsKartAdmittedFor(int32 KartId, int32 RaceInstanceId, const AActor* Viewer) const;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Number of pawns of the default pawn class spawned up front when the map loads */
+	UPROPERTY(EditDefaultsOnly, Category = "Pawn Pool")
+	int32 PawnPoolSize = 4;
+
+	/**
+	 * Independent races hosted in this world. Each gets its own copy of the track, far enough from the others that they never interact.
+	 * More than one needs RaceInstanceLevel; without it the server hosts a single race.
+	 */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Race Instances")
+	int32 MaxRaceInstances = 1;
+
+	/** Players placed in a race instance before the next one is opened */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Race Instances")
+	int32 MaxPlayersPerRace = 8;
+
+	/** Distance between race instances (cm). Instances are laid out in rows of four, so keep this within world bounds. */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Race Instances")
+	float RaceInstanceSpacing = 200000.f;
+
+	/**
+	 * Long package name of the track level instanced for every race but the first, which uses the persistent level.
+	 * It should hold only the track: player starts stay in the persistent level and are offset to each race.
+	 */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Race Instances")
+	FString RaceInstanceLevel;
+
+	/** Spectator relay (host:port) the server streams the kart snapshot to, see UGoKartSpectatorRelayCommandlet. Empty to not stream. */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Spectators")
+	FString SpectatorRelayAddress;
+
+	/** Race instance whose kart snapshot is streamed to the spectator relay */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Spectators")
+	int32 SpectatedRaceInstance = 0;
+
+	/** Kart snapshots streamed to the spectator relay per second. Spectators interpolate, so this can be well below the tick rate. */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Spectators")
+	float SpectatorBroadcastRate = 10.f;
+
+	/** Most bots added to a race to fill the slots players haven't taken, see AGoKartAIManager. Races without players get none. 0 for no bots. */
+	UPROPERTY(Config, EditDefaultsOnly, Category = "Bots")
+	int32 MaxBotsPerRace = 8;
+
+	/** Kart spawned for bots. Needs a UGoKartMovementComponent. */
+	UPROPERTY(EditDefaultsOnly, Category = "Bots")
+	TSubclassOf<APawn> BotPawnClass;
+
+private:
+	APawn* SpawnPooledPawn(UClass* PawnClass, const FTransform& SpawnTransform);
+
+	APawn* AcquirePawn(UClass* PawnClass, const FTransform& SpawnTransform);
+
+	void DeactivatePawn(APawn* Pawn);
+
+	void ActivatePawn(APawn* Pawn, const FTransform& SpawnTransform);
+
+	void AssignRaceInstance(APlayerController* Player, int32 PreferredInstanceId);
+
+	/** Add or remove bots so the race's empty slots are filled, up to MaxBotsPerRace */
+	void UpdateBots(int32 RaceInstanceId);
+
+	UPROPERTY(Transient)
+	AGoKartAIManager* AIManager;
+
+	UPROPERTY(Transient)
+	TArray<FNetworkRacersRaceInstance> RaceInstances;
+
+	void BroadcastToSpectators();
+
+	FGoKartSpectatorBroadcaster SpectatorBroadcaster;
+	FTimerHandle SpectatorBroadcastTimer;
+
+	/** Relay we are spectating through, when started with -SpectatorRelay */
+	FString SpectateRelayAddress;
+
+	/** Snapshot streams of players that joined while karts were already racing, one per player */
+	UPROPERTY(Transient)
+	TArray<AGoKartSnapshotStream*> SnapshotStreams;
+
+	/** Pawns that are spawned but currently unused. Kept hidden, without collision, ticking or replication updates. */
+	UPROPERTY(Transient)
+	TArray<APawn*> PooledPawns;
+
 };
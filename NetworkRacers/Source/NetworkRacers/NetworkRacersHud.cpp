@@ -9,21 +9,45 @@
 #include "WheeledVehicleMovementComponent.h"
 #include "Engine/Font.h"
 #include "CanvasItem.h"
-#include "UObject/ConstructorHelpers.h"
 #include "Engine/Engine.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
 
 #define LOCTEXT_NAMESPACE "VehicleHUD"
 
 ANetworkRacersHud::ANetworkRacersHud()
 {
-	static ConstructorHelpers::FObjectFinder<UFont> Font(TEXT("/Engine/EngineFonts/RobotoDistanceField"));
-	HUDFont = Font.Object;
+	HUDFontAsset = TSoftObjectPtr<UFont>(FSoftObjectPath(TEXT("/Engine/EngineFonts/RobotoDistanceField.RobotoDistanceField")));
+}
+
+void ANetworkRacersHud::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Usually already resident thanks to the map's preload manifest
+	HUDFont = HUDFontAsset.Get();
+	if ((HUDFont == nullptr) && !HUDFontAsset.IsNull())
+	{
+		FStreamableManager& Streamable = UAssetManager::GetStreamableManager();
+		HUDFontHandle = Streamable.RequestAsyncLoad(HUDFontAsset.ToSoftObjectPath(), FStreamableDelegate::CreateUObject(this, &ANetworkRacersHud::OnHUDFontLoaded));
+	}
+}
+
+void ANetworkRacersHud::OnHUDFontLoaded()
+{
+	HUDFont = HUDFontAsset.Get();
+	HUDFontHandle.Reset();
 }
 
 void ANetworkRacersHud::DrawHUD()
 {
 	Super::DrawHUD();
 
+	if (HUDFont == nullptr)
+	{
+		return;
+	}
+
 	// Calculate ratio from 720p
 	const float HUDXRatio = Canvas->SizeX / 1280.f;
 	const float HUDYRatio = Canvas->SizeY / 720.f;
@@ -39,20 +63,44 @@ void ANetworkRacersHud::DrawHUD()
 		ANetworkRacersPawn* Vehicle = Cast<ANetworkRacersPawn>(GetOwningPawn());
 		if ((Vehicle != nullptr) && (Vehicle->bInCarCameraActive == false))
 		{
-			FVector2D ScaleVec(HUDYRatio * 1.4f, HUDYRatio * 1.4f);
-
-			// Speed
-			FCanvasTextItem SpeedTextItem(FVector2D(HUDXRatio * 805.f, HUDYRatio * 455), Vehicle->SpeedDisplayString, HUDFont, FLinearColor::White);
-			SpeedTextItem.Scale = ScaleVec;
-			Canvas->DrawItem(SpeedTextItem);
+			UpdateTextItems(Vehicle, HUDXRatio, HUDYRatio);
 
-			// Gear
-			FCanvasTextItem GearTextItem(FVector2D(HUDXRatio * 805.f, HUDYRatio * 500.f), Vehicle->GearDisplayString, HUDFont, Vehicle->bInReverseGear == false ? Vehicle->GearDisplayColor : Vehicle->GearDisplayReverseColor);
-			GearTextItem.Scale = ScaleVec;
-			Canvas->DrawItem(GearTextItem);
+			// The canvas is immediate mode so the items are drawn every frame, but they are only rebuilt when something changed
+			Canvas->DrawItem(*SpeedTextItem);
+			Canvas->DrawItem(*GearTextItem);
 		}
 	}
 }
 
+void ANetworkRacersHud::UpdateTextItems(ANetworkRacersPawn* Vehicle, float HUDXRatio, float HUDYRatio)
+{
+	const FIntPoint CanvasSize(Canvas->SizeX, Canvas->SizeY);
+	const bool bLayoutChanged = !SpeedTextItem.IsValid() || (CanvasSize != CachedCanvasSize) || (Vehicle != CachedVehicle.Get());
+	if (bLayoutChanged)
+	{
+		FVector2D ScaleVec(HUDYRatio * 1.4f, HUDYRatio * 1.4f);
+
+		// Speed
+		SpeedTextItem = MakeUnique<FCanvasTextItem>(FVector2D(HUDXRatio * 805.f, HUDYRatio * 455), Vehicle->SpeedDisplayString, HUDFont, FLinearColor::White);
+		SpeedTextItem->Scale = ScaleVec;
+
+		// Gear
+		GearTextItem = MakeUnique<FCanvasTextItem>(FVector2D(HUDXRatio * 805.f, HUDYRatio * 500.f), Vehicle->GearDisplayString, HUDFont, FLinearColor::White);
+		GearTextItem->Scale = ScaleVec;
+
+		CachedCanvasSize = CanvasSize;
+		CachedVehicle = Vehicle;
+	}
+
+	if (bLayoutChanged || (Vehicle->HUDTextVersion != CachedHUDTextVersion))
+	{
+		SpeedTextItem->Text = Vehicle->SpeedDisplayString;
+		GearTextItem->Text = Vehicle->GearDisplayString;
+		GearTextItem->SetColor(Vehicle->bInReverseGear == false ? Vehicle->GearDisplayColor : Vehicle->GearDisplayReverseColor);
+
+		CachedHUDTextVersion = Vehicle->HUDTextVersion;
+	}
+}
+
 
 #undef LOCTEXT_NAMESPACE
@@ -1,8 +1,12 @@
 // Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
 #pragma once
 #include "GameFramework/HUD.h"
+#include "CanvasItem.h"
 #include "NetworkRacersHud.generated.h"
 
+struct FStreamableHandle;
+class ANetworkRacersPawn;
+
 
 UCLASS(config = Game)
 class ANetworkRacersHud : public AHUD
@@ -12,11 +16,35 @@ class ANetworkRacersHud : public AHUD
 public:
 	ANetworkRacersHud();
 
-	/** Font used to render the vehicle info */
+	/** Font used to render the vehicle info. Streamed in from HUDFontAsset, nothing is drawn until it arrives */
 	UPROPERTY()
 	UFont* HUDFont;
 
+	/** Font to stream in for the vehicle info */
+	UPROPERTY(EditDefaultsOnly)
+	TSoftObjectPtr<UFont> HUDFontAsset;
+
 	// Begin AHUD interface
 	virtual void DrawHUD() override;
 	// End AHUD interface
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	void OnHUDFontLoaded();
+
+	/** Rebuild the cached text items if the layout or the vehicle's text changed */
+	void UpdateTextItems(ANetworkRacersPawn* Vehicle, float HUDXRatio, float HUDYRatio);
+
+	TSharedPtr<FStreamableHandle> HUDFontHandle;
+
+	/** Text items kept between frames, see UpdateTextItems */
+	TUniquePtr<FCanvasTextItem> SpeedTextItem;
+	TUniquePtr<FCanvasTextItem> GearTextItem;
+
+	/** What the cached text items were built for */
+	FIntPoint CachedCanvasSize = FIntPoint::ZeroValue;
+	TWeakObjectPtr<ANetworkRacersPawn> CachedVehicle;
+	uint32 CachedHUDTextVersion = 0;
 };
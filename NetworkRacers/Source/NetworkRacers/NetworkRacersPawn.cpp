@@ -4,17 +4,24 @@
 #include "NetworkRacersWheelFront.h"
 #include "NetworkRacersWheelRear.h"
 #include "NetworkRacersHud.h"
+#include "NetworkRacersVehicleMovementComponent.h"
+#include "Vehicle/GoKartMovementReplicator.h"
+#include "NetworkRacersGameMode.h"
+#include "Engine/World.h"
 #include "Components/SkeletalMeshComponent.h"
 #include "GameFramework/SpringArmComponent.h"
 #include "Camera/CameraComponent.h"
 #include "Components/InputComponent.h"
 #include "WheeledVehicleMovementComponent4W.h"
 #include "Engine/SkeletalMesh.h"
+#include "PhysicsEngine/PhysicsAsset.h"
 #include "Engine/Engine.h"
-#include "UObject/ConstructorHelpers.h"
 #include "Components/TextRenderComponent.h"
 #include "Materials/Material.h"
 #include "GameFramework/Controller.h"
+#include "Animation/AnimInstance.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
 
 // Needed for VR Headset
 #if HMD_MODULE_INCLUDED
@@ -27,14 +34,12 @@ const FName ANetworkRacersPawn::LookRightBinding("LookRight");
 
 #define LOCTEXT_NAMESPACE "VehiclePawn"
 
-ANetworkRacersPawn::ANetworkRacersPawn()
+ANetworkRacersPawn::ANetworkRacersPawn(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UNetworkRacersVehicleMovementComponent>(AWheeledVehicle::VehicleMovementComponentName))
 {
-	// Car mesh
-	static ConstructorHelpers::FObjectFinder<USkeletalMesh> CarMesh(TEXT("/Game/Vehicle/Sedan/Sedan_SkelMesh.Sedan_SkelMesh"));
-	GetMesh()->SetSkeletalMesh(CarMesh.Object);
-
-	static ConstructorHelpers::FClassFinder<UObject> AnimBPClass(TEXT("/Game/Vehicle/Sedan/Sedan_AnimBP"));
-	GetMesh()->SetAnimInstanceClass(AnimBPClass.Class);
+	// Car mesh and animation are soft references, resolved in PreRegisterAllComponents once the preload manifest has streamed them in
+	CarMeshAsset = TSoftObjectPtr<USkeletalMesh>(FSoftObjectPath(TEXT("/Game/Vehicle/Sedan/Sedan_SkelMesh.Sedan_SkelMesh")));
+	CarAnimClass = TSoftClassPtr<UAnimInstance>(FSoftObjectPath(TEXT("/Game/Vehicle/Sedan/Sedan_AnimBP.Sedan_AnimBP_C")));
 	
 	// Simulation
 	UWheeledVehicleMovementComponent4W* Vehicle4W = CastChecked<UWheeledVehicleMovementComponent4W>(GetVehicleMovement());
@@ -57,6 +62,12 @@ ANetworkRacersPawn::ANetworkRacersPawn()
 	Vehicle4W->WheelSetups[3].BoneName = FName("Wheel_Rear_Right");
 	Vehicle4W->WheelSetups[3].AdditionalOffset = FVector(0.f, 12.f, 0.f);
 
+	// Movement is replicated by our own move/ack/replay scheme rather than the engine's physics replication
+	bReplicateMovement = false;
+	MovementReplicator = CreateDefaultSubobject<UGoKartMovementReplicator>(TEXT("MovementReplicator"));
+
+	// Cameras and in-car text are never looked at on a dedicated server, so the server build doesn't create them.
+#if !UE_SERVER
 	// Create a spring arm component
 	SpringArm = CreateDefaultSubobject<USpringArmComponent>(TEXT("SpringArm0"));
 	SpringArm->TargetOffset = FVector(0.f, 0.f, 200.f);
@@ -87,13 +98,10 @@ ANetworkRacersPawn::ANetworkRacersPawn()
 	InternalCamera->SetupAttachment(InternalCameraBase);
 
 	//Setup TextRenderMaterial
-	static ConstructorHelpers::FObjectFinder<UMaterial> TextMaterial(TEXT("Material'/Engine/EngineMaterials/AntiAliasedTextMaterialTranslucent.AntiAliasedTextMaterialTranslucent'"));
-	
-	UMaterialInterface* Material = TextMaterial.Object;
+	TextMaterialAsset = TSoftObjectPtr<UMaterialInterface>(FSoftObjectPath(TEXT("/Engine/EngineMaterials/AntiAliasedTextMaterialTranslucent.AntiAliasedTextMaterialTranslucent")));
 
 	// Create text render component for in car speed display
 	InCarSpeed = CreateDefaultSubobject<UTextRenderComponent>(TEXT("IncarSpeed"));
-	InCarSpeed->SetTextMaterial(Material);
 	InCarSpeed->SetRelativeLocation(FVector(70.0f, -75.0f, 99.0f));
 	InCarSpeed->SetRelativeRotation(FRotator(18.0f, 180.0f, 0.0f));
 	InCarSpeed->SetupAttachment(GetMesh());
@@ -101,23 +109,117 @@ ANetworkRacersPawn::ANetworkRacersPawn()
 
 	// Create text render component for in car gear display
 	InCarGear = CreateDefaultSubobject<UTextRenderComponent>(TEXT("IncarGear"));
-	InCarGear->SetTextMaterial(Material);
 	InCarGear->SetRelativeLocation(FVector(66.0f, -9.0f, 95.0f));	
 	InCarGear->SetRelativeRotation(FRotator(25.0f, 180.0f,0.0f));
 	InCarGear->SetRelativeScale3D(FVector(1.0f, 0.4f, 0.4f));
 	InCarGear->SetupAttachment(GetMesh());
 	
-	// Colors for the incar gear display. One for normal one for reverse
-	GearDisplayReverseColor = FColor(255, 0, 0, 255);
-	GearDisplayColor = FColor(255, 255, 255, 255);
-
 	// Colors for the in-car gear display. One for normal one for reverse
 	GearDisplayReverseColor = FColor(255, 0, 0, 255);
 	GearDisplayColor = FColor(255, 255, 255, 255);
+#endif // !UE_SERVER
 
 	bInReverseGear = false;
 }
 
+void ANetworkRacersPawn::PreRegisterAllComponents()
+{
+	Super::PreRegisterAllComponents();
+
+	UWorld* World = GetWorld();
+	const bool bIsGameWorld = (World != nullptr) && World->IsGameWorld();
+
+	// The mesh has to be in place before the vehicle creates its physics state, so it can't wait for streaming.
+	if ((GetMesh()->SkeletalMesh == nullptr) && !CarMeshAsset.IsNull())
+	{
+		USkeletalMesh* CarMesh = CarMeshAsset.Get();
+		if (CarMesh == nullptr)
+		{
+			UE_CLOG(bIsGameWorld, LogTemp, Warning, TEXT("%s was not preloaded for this map, loading it synchronously."), *CarMeshAsset.ToString());
+			CarMesh = CarMeshAsset.LoadSynchronous();
+		}
+		GetMesh()->SetSkeletalMesh(CarMesh);
+	}
+
+	// Dedicated servers never draw the car, so they don't need anything cosmetic.
+	if (IsNetMode(NM_DedicatedServer))
+	{
+		if (bLightweightServerMesh)
+		{
+			ConfigureServerMesh();
+		}
+		return;
+	}
+
+	// Editor previews can't wait for streaming either.
+	if (!bIsGameWorld)
+	{
+		CarAnimClass.LoadSynchronous();
+		TextMaterialAsset.LoadSynchronous();
+		ApplyCosmeticAssets();
+		return;
+	}
+
+	TArray<FSoftObjectPath> AssetsToStream;
+	if (!CarAnimClass.IsNull() && CarAnimClass.Get() == nullptr)
+	{
+		AssetsToStream.Add(CarAnimClass.ToSoftObjectPath());
+	}
+	if (!TextMaterialAsset.IsNull() && TextMaterialAsset.Get() == nullptr)
+	{
+		AssetsToStream.Add(TextMaterialAsset.ToSoftObjectPath());
+	}
+
+	if (AssetsToStream.Num() == 0)
+	{
+		ApplyCosmeticAssets();
+	}
+	else
+	{
+		FStreamableManager& Streamable = UAssetManager::GetStreamableManager();
+		CosmeticAssetsHandle = Streamable.RequestAsyncLoad(AssetsToStream, FStreamableDelegate::CreateUObject(this, &ANetworkRacersPawn::ApplyCosmeticAssets));
+	}
+}
+
+void ANetworkRacersPawn::ConfigureServerMesh()
+{
+	USkeletalMeshComponent* CarMesh = GetMesh();
+
+	// Swap in the simplified body before the components register and create their physics state
+	if (!ServerPhysicsAsset.IsNull())
+	{
+		if (UPhysicsAsset* PhysicsAsset = ServerPhysicsAsset.LoadSynchronous())
+		{
+			CarMesh->SetPhysicsAsset(PhysicsAsset);
+		}
+	}
+
+	// Wheel placement comes from the PhysX suspension raycasts, not from the animated wheel bones
+	CarMesh->SetAnimInstanceClass(nullptr);
+	CarMesh->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+	CarMesh->KinematicBonesUpdateToPhysics = EKinematicBonesUpdateToPhysics::SkipAllBones;
+	CarMesh->bComponentUseFixedSkelBounds = true;
+	CarMesh->bDisableClothSimulation = true;
+	CarMesh->bEnableUpdateRateOptimizations = true;
+}
+
+void ANetworkRacersPawn::ApplyCosmeticAssets()
+{
+	if (UClass* AnimClass = CarAnimClass.Get())
+	{
+		GetMesh()->SetAnimInstanceClass(AnimClass);
+	}
+
+	UMaterialInterface* Material = TextMaterialAsset.Get();
+	if ((Material != nullptr) && (InCarSpeed != nullptr) && (InCarGear != nullptr))
+	{
+		InCarSpeed->SetTextMaterial(Material);
+		InCarGear->SetTextMaterial(Material);
+	}
+
+	CosmeticAssetsHandle.Reset();
+}
+
 void ANetworkRacersPawn::SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent)
 {
 	Super::SetupPlayerInputComponent(PlayerInputComponent);
@@ -164,6 +266,11 @@ void ANetworkRacersPawn::OnToggleCamera()
 
 void ANetworkRacersPawn::EnableIncarView(const bool bState, const bool bForce)
 {
+	if ((Camera == nullptr) || (InternalCamera == nullptr))
+	{
+		return;
+	}
+
 	if ((bState != bInCarCameraActive) || ( bForce == true ))
 	{
 		bInCarCameraActive = bState;
@@ -192,12 +299,18 @@ void ANetworkRacersPawn::Tick(float Delta)
 
 	// Setup the flag to say we are in reverse gear
 	bInReverseGear = GetVehicleMovement()->GetCurrentGear() < 0;
-	
-	// Update the strings used in the hud (incar and onscreen)
-	UpdateHUDStrings();
 
-	// Set the string in the incar hud
-	SetupInCarHUD();
+#if !UE_SERVER
+	// Only the local player's HUD shows these, so remote vehicles don't need to format them
+	if (IsLocallyControlled())
+	{
+		// Update the strings used in the hud (incar and onscreen)
+		UpdateHUDStrings();
+
+		// Set the string in the incar hud
+		SetupInCarHUD();
+	}
+#endif // !UE_SERVER
 
 	bool bHMDActive = false;
 #if HMD_MODULE_INCLUDED
@@ -208,7 +321,7 @@ void ANetworkRacersPawn::Tick(float Delta)
 #endif // HMD_MODULE_INCLUDED
 	if (bHMDActive == false)
 	{
-		if ( (InputComponent) && (bInCarCameraActive == true ))
+		if ( (InputComponent) && (InternalCamera) && (bInCarCameraActive == true ))
 		{
 			FRotator HeadRotation = InternalCamera->RelativeRotation;
 			HeadRotation.Pitch += InputComponent->GetAxisValue(LookUpBinding);
@@ -219,6 +332,36 @@ void ANetworkRacersPawn::Tick(float Delta)
 	}
 }
 
+bool ANetworkRacersPawn::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	// Vehicles are only replicated within their race, and players joining mid-race receive them a few at a time
+	if (MovementReplicator != nullptr && !MovementReplicator->IsAdmittedFor(RealViewer))
+	{
+		return false;
+	}
+
+	return Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation);
+}
+
+void ANetworkRacersPawn::FellOutOfWorld(const UDamageType& DamageType)
+{
+	// Vehicles are pooled, so one that falls off the track goes back to the pool and is replaced rather than destroyed.
+	// Clients leave it to the server.
+	if (!HasAuthority())
+	{
+		return;
+	}
+
+	ANetworkRacersGameMode* GameMode = GetWorld()->GetAuthGameMode<ANetworkRacersGameMode>();
+	if (GameMode == nullptr)
+	{
+		Super::FellOutOfWorld(DamageType);
+		return;
+	}
+
+	GameMode->RespawnPawn(this);
+}
+
 void ANetworkRacersPawn::BeginPlay()
 {
 	Super::BeginPlay();
@@ -242,27 +385,83 @@ void ANetworkRacersPawn::OnResetVR()
 #endif // HMD_MODULE_INCLUDED
 }
 
+#if !UE_SERVER
+namespace
+{
+	/** Speeds up to this are formatted once and shared by every vehicle. Faster than this is formatted on demand. */
+	const int32 MaxPrecomputedKPH = 400;
+
+	/** Forward gears up to this are formatted once and shared by every vehicle */
+	const int32 MaxPrecomputedGear = 9;
+
+	FText GetSpeedDisplayText(int32 KPH)
+	{
+		static TArray<FText> SpeedTexts;
+		if (SpeedTexts.Num() == 0)
+		{
+			SpeedTexts.Reserve(MaxPrecomputedKPH + 1);
+			for (int32 Speed = 0; Speed <= MaxPrecomputedKPH; ++Speed)
+			{
+				// Formatted text is rebuilt by the text system if the culture changes, so caching it is safe
+				SpeedTexts.Add(FText::Format(LOCTEXT("SpeedFormat", "{0} km/h"), FText::AsNumber(Speed)));
+			}
+		}
+
+		return SpeedTexts.IsValidIndex(KPH) ? SpeedTexts[KPH] : FText::Format(LOCTEXT("SpeedFormat", "{0} km/h"), FText::AsNumber(KPH));
+	}
+
+	FText GetGearDisplayText(int32 Gear)
+	{
+		static TArray<FText> GearTexts;
+		if (GearTexts.Num() == 0)
+		{
+			GearTexts.Reserve(MaxPrecomputedGear + 1);
+			GearTexts.Add(LOCTEXT("N", "N"));
+			for (int32 ForwardGear = 1; ForwardGear <= MaxPrecomputedGear; ++ForwardGear)
+			{
+				GearTexts.Add(FText::AsNumber(ForwardGear));
+			}
+		}
+
+		if (Gear < 0)
+		{
+			return LOCTEXT("ReverseGear", "R");
+		}
+		return GearTexts.IsValidIndex(Gear) ? GearTexts[Gear] : FText::AsNumber(Gear);
+	}
+}
+
 void ANetworkRacersPawn::UpdateHUDStrings()
 {
 	float KPH = FMath::Abs(GetVehicleMovement()->GetForwardSpeed()) * 0.036f;
 	int32 KPH_int = FMath::FloorToInt(KPH);
+	int32 Gear = GetVehicleMovement()->GetCurrentGear();
 
-	// Using FText because this is display text that should be localizable
-	SpeedDisplayString = FText::Format(LOCTEXT("SpeedFormat", "{0} km/h"), FText::AsNumber(KPH_int));
-	
-	if (bInReverseGear == true)
+	// The displayed values only change a few times a second, so most frames there is nothing to do
+	if ((KPH_int == DisplayedKPH) && (Gear == DisplayedGear))
 	{
-		GearDisplayString = FText(LOCTEXT("ReverseGear", "R"));
+		return;
 	}
-	else
-	{
-		int32 Gear = GetVehicleMovement()->GetCurrentGear();
-		GearDisplayString = (Gear == 0) ? LOCTEXT("N", "N") : FText::AsNumber(Gear);
-	}	
+
+	DisplayedKPH = KPH_int;
+	DisplayedGear = Gear;
+
+	// Using FText because this is display text that should be localizable
+	SpeedDisplayString = GetSpeedDisplayText(KPH_int);
+	GearDisplayString = GetGearDisplayText(Gear);
+
+	++HUDTextVersion;
+	bInCarHUDDirty = true;
 }
 
 void ANetworkRacersPawn::SetupInCarHUD()
 {
+	// Text render components re-create their render state on every change, so only touch them when the text changed
+	if (!bInCarHUDDirty)
+	{
+		return;
+	}
+
 	APlayerController* PlayerController = Cast<APlayerController>(GetController());
 	if ((PlayerController != nullptr) && (InCarSpeed != nullptr) && (InCarGear != nullptr) )
 	{
@@ -278,7 +477,10 @@ void ANetworkRacersPawn::SetupInCarHUD()
 		{
 			InCarGear->SetTextRenderColor(GearDisplayReverseColor);
 		}
+
+		bInCarHUDDirty = false;
 	}
 }
+#endif // !UE_SERVER
 
 #undef LOCTEXT_NAMESPACE
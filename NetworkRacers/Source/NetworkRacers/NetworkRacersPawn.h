@@ -10,6 +10,11 @@ class UCameraComponent;
 class USpringArmComponent;
 class UTextRenderComponent;
 class UInputComponent;
+class UGoKartMovementReplicator;
+class UAnimInstance;
+class UMaterialInterface;
+class UPhysicsAsset;
+struct FStreamableHandle;
 
 UCLASS(config=Game)
 class ANetworkRacersPawn : public AWheeledVehicle
@@ -40,9 +45,13 @@ class ANetworkRacersPawn : public AWheeledVehicle
 	UPROPERTY(Category = Display, VisibleDefaultsOnly, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	UTextRenderComponent* InCarGear;
 
+	/** Predicts, acknowledges and reconciles the vehicle's moves, in place of default movement replication */
+	UPROPERTY(Category = Replication, VisibleDefaultsOnly, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	UGoKartMovementReplicator* MovementReplicator;
+
 	
 public:
-	ANetworkRacersPawn();
+	ANetworkRacersPawn(const FObjectInitializer& ObjectInitializer);
 
 	/** The current speed as a string eg 10 km/h */
 	UPROPERTY(Category = Display, VisibleDefaultsOnly, BlueprintReadOnly)
@@ -68,6 +77,32 @@ public:
 	UPROPERTY(Category = Camera, VisibleDefaultsOnly, BlueprintReadOnly)
 	bool bInReverseGear;
 
+	/** Incremented whenever SpeedDisplayString or GearDisplayString change, so the HUD can tell when to rebuild */
+	uint32 HUDTextVersion = 0;
+
+	/** Sedan mesh. The vehicle simulation needs it, so it is loaded synchronously if the map's preload manifest missed it */
+	UPROPERTY(Category = Display, EditDefaultsOnly)
+	TSoftObjectPtr<USkeletalMesh> CarMeshAsset;
+
+	/** Animation blueprint driving the wheels. Cosmetic, streamed on clients and skipped on dedicated servers */
+	UPROPERTY(Category = Display, EditDefaultsOnly)
+	TSoftClassPtr<UAnimInstance> CarAnimClass;
+
+	/** Material for the in-car text. Cosmetic, streamed on clients and skipped on dedicated servers */
+	UPROPERTY(Category = Display, EditDefaultsOnly)
+	TSoftObjectPtr<UMaterialInterface> TextMaterialAsset;
+
+	/**
+	 * On dedicated servers, skip everything the sedan mesh does purely for looks: pose evaluation, bone transform
+	 * updates and pushing animated bones to physics. The vehicle still simulates against the mesh's root body.
+	 */
+	UPROPERTY(Category = Simulation, Config, EditDefaultsOnly)
+	bool bLightweightServerMesh = true;
+
+	/** Optional simplified physics asset (eg. a single box) swapped in for the vehicle on dedicated servers */
+	UPROPERTY(Category = Simulation, EditDefaultsOnly)
+	TSoftObjectPtr<UPhysicsAsset> ServerPhysicsAsset;
+
 	/** Initial offset of incar camera */
 	FVector InternalCameraOrigin;
 	// Begin Pawn interface
@@ -76,6 +111,9 @@ public:
 
 	// Begin Actor interface
 	virtual void Tick(float Delta) override;
+	virtual void PreRegisterAllComponents() override;
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+	virtual void FellOutOfWorld(const class UDamageType& DamageType) override;
 protected:
 	virtual void BeginPlay() override;
 
@@ -84,8 +122,10 @@ public:
 
 	/** Handle pressing forwards */
 	void MoveForward(float Val);
+#if !UE_SERVER
 	/** Setup the strings used on the hud */
 	void SetupInCarHUD();
+#endif // !UE_SERVER
 
 	/** Update the physics material used by the vehicle mesh */
 	void UpdatePhysicsMaterial();
@@ -112,8 +152,26 @@ private:
 	 */
 	void EnableIncarView( const bool bState, const bool bForce = false );
 
+#if !UE_SERVER
 	/** Update the gear and speed strings */
 	void UpdateHUDStrings();
+#endif // !UE_SERVER
+
+	/** Speed and gear the display strings were last built for */
+	int32 DisplayedKPH = INDEX_NONE;
+	int32 DisplayedGear = MIN_int32;
+
+	/** The in-car text components need the current strings */
+	bool bInCarHUDDirty = true;
+
+	/** Strip the mesh down to what the vehicle simulation needs on a dedicated server */
+	void ConfigureServerMesh();
+
+	/** Apply the animation blueprint and text material once they are resident */
+	void ApplyCosmeticAssets();
+
+	/** Keeps streamed cosmetic assets alive while they are being loaded */
+	TSharedPtr<FStreamableHandle> CosmeticAssetsHandle;
 
 	/* Are we on a 'slippery' surface */
 	bool bIsLowFriction;
@@ -130,4 +188,6 @@ public:
 	FORCEINLINE UTextRenderComponent* GetInCarSpeed() const { return InCarSpeed; }
 	/** Returns InCarGear subobject **/
 	FORCEINLINE UTextRenderComponent* GetInCarGear() const { return InCarGear; }
+	/** Returns MovementReplicator subobject **/
+	FORCEINLINE UGoKartMovementReplicator* GetMovementReplicator() const { return MovementReplicator; }
 };
@@ -0,0 +1,68 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "NetworkRacersPlayerController.h"
+#include "NetworkRacersGameMode.h"
+#include "Engine/World.h"
+#include "Engine/LevelStreamingKismet.h"
+#include "UnrealNetwork.h"
+
+ANetworkRacersPlayerController::ANetworkRacersPlayerController()
+{
+	RaceInstanceId = INDEX_NONE;
+	RaceInstanceOrigin = FVector::ZeroVector;
+	LoadedRaceLevel = nullptr;
+}
+
+void ANetworkRacersPlayerController::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	DOREPLIFETIME(ANetworkRacersPlayerController, RaceInstanceId);
+	DOREPLIFETIME(ANetworkRacersPlayerController, RaceInstanceOrigin);
+	DOREPLIFETIME(ANetworkRacersPlayerController, RaceInstanceLevel);
+}
+
+void ANetworkRacersPlayerController::SetRaceInstance(int32 InstanceId, const FVector& Origin, const FString& LevelName)
+{
+	RaceInstanceId = InstanceId;
+	RaceInstanceOrigin = Origin;
+	RaceInstanceLevel = LevelName;
+
+	ForceNetUpdate();
+}
+
+void ANetworkRacersPlayerController::Possess(APawn* aPawn)
+{
+	APawn* PreviousPawn = GetPawn();
+
+	Super::Possess(aPawn);
+
+	ANetworkRacersGameMode* GameMode = GetWorld()->GetAuthGameMode<ANetworkRacersGameMode>();
+	if (GameMode != nullptr && PreviousPawn != nullptr && PreviousPawn != GetPawn())
+	{
+		GameMode->ReleasePawn(PreviousPawn);
+	}
+}
+
+void ANetworkRacersPlayerController::OnRep_RaceInstance()
+{
+	// Only the track of our own race is loaded, races in other instances are never relevant to us
+	if (LoadedRaceLevel != nullptr)
+	{
+		LoadedRaceLevel->bShouldBeLoaded = false;
+		LoadedRaceLevel->bShouldBeVisible = false;
+		LoadedRaceLevel = nullptr;
+	}
+
+	if (RaceInstanceLevel.IsEmpty())
+	{
+		return;
+	}
+
+	bool bSuccess = false;
+	LoadedRaceLevel = ULevelStreamingKismet::LoadLevelInstance(this, RaceInstanceLevel, RaceInstanceOrigin, FRotator::ZeroRotator, bSuccess);
+	if (!bSuccess)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't load race instance %d track %s."), RaceInstanceId, *RaceInstanceLevel);
+	}
+}
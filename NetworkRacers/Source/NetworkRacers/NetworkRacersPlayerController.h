@@ -0,0 +1,45 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+#pragma once
+#include "GameFramework/PlayerController.h"
+#include "NetworkRacersPlayerController.generated.h"
+
+class ULevelStreaming;
+
+UCLASS()
+class ANetworkRacersPlayerController : public APlayerController
+{
+	GENERATED_BODY()
+
+public:
+	ANetworkRacersPlayerController();
+
+	/** Server: place the player in a race instance. Its track is loaded on the owning client at Origin. */
+	void SetRaceInstance(int32 InstanceId, const FVector& Origin, const FString& LevelName);
+
+	/** Race instance the player is in, INDEX_NONE before the game mode has placed them */
+	int32 GetRaceInstanceId() const { return RaceInstanceId; }
+
+	const FVector& GetRaceInstanceOrigin() const { return RaceInstanceOrigin; }
+
+	/** Return a pawn we are moved off to the game mode's pool rather than leaving it in the world */
+	virtual void Possess(APawn* aPawn) override;
+
+private:
+	UFUNCTION()
+	void OnRep_RaceInstance();
+
+	UPROPERTY(ReplicatedUsing = OnRep_RaceInstance)
+	int32 RaceInstanceId;
+
+	UPROPERTY(Replicated)
+	FVector RaceInstanceOrigin;
+
+	/** Long package name of the track loaded at RaceInstanceOrigin, empty if the race uses the persistent level */
+	UPROPERTY(Replicated)
+	FString RaceInstanceLevel;
+
+	/** Client: track instance loaded for our race */
+	UPROPERTY(Transient)
+	ULevelStreaming* LoadedRaceLevel;
+
+};
@@ -0,0 +1,311 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#include "NetworkRacersVehicleMovementComponent.h"
+#include "GameFramework/Actor.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Controller.h"
+#include "VehicleWheel.h"
+#include "TireConfig.h"
+
+namespace NetworkRacersVehicleMovement
+{
+	/** Most move time the server holds waiting to be applied (s) */
+	const float MaxScheduledTime = 0.25f;
+
+	/** kg/m^3 */
+	const float AirDensity = 1.225f;
+
+	/** Car tyres on tarmac */
+	const float RollingResistanceCoefficient = 0.015f;
+}
+
+UNetworkRacersVehicleMovementComponent::UNetworkRacersVehicleMovementComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+void UNetworkRacersVehicleMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	// Same roles as UGoKartMovementComponent: the owning client and the server for its own vehicles build moves from local input
+	if ((GetOwnerRole() == ROLE_AutonomousProxy) || (GetOwner()->GetRemoteRole() == ROLE_SimulatedProxy))
+	{
+		PrevMove.DeltaTime = DeltaTime;
+		PrevMove.Throttle = RawThrottleInput;
+		PrevMove.SteeringThrow = RawSteeringInput;
+		PrevMove.bHandbrake = bRawHandbrakeInput;
+
+		// The replicator stamps moves with its synchronized server clock when it sends them
+		PrevMove.TimeStamp = 0;
+	}
+}
+
+void UNetworkRacersVehicleMovementComponent::UpdateState(float DeltaTime)
+{
+	// On the owning client, do what the engine does for a locally controlled vehicle except send ServerUpdateState:
+	// the server gets our input as moves from UGoKartMovementReplicator instead
+	AController* Controller = GetController();
+	if (GetOwnerRole() == ROLE_Authority || Controller == nullptr || !Controller->IsLocalController())
+	{
+		Super::UpdateState(DeltaTime);
+		return;
+	}
+
+	SteeringInput = SteeringInputRate.InterpInputValue(DeltaTime, SteeringInput, CalcSteeringInput());
+	ThrottleInput = ThrottleInputRate.InterpInputValue(DeltaTime, ThrottleInput, CalcThrottleInput());
+	BrakeInput = BrakeInputRate.InterpInputValue(DeltaTime, BrakeInput, CalcBrakeInput());
+	HandbrakeInput = HandbrakeInputRate.InterpInputValue(DeltaTime, HandbrakeInput, CalcHandbrakeInput());
+}
+
+void UNetworkRacersVehicleMovementComponent::UpdateSimulation(float DeltaTime)
+{
+	// Apply the move this substep starts in, and use up the substep's time from the schedule
+	if (ScheduledMoves.Num() > 0)
+	{
+		ApplyMoveInput(ScheduledMoves[0]);
+		SteeringInput = CalcSteeringInput();
+		ThrottleInput = CalcThrottleInput();
+		BrakeInput = CalcBrakeInput();
+		HandbrakeInput = CalcHandbrakeInput();
+
+		float Remaining = DeltaTime;
+		while (Remaining > KINDA_SMALL_NUMBER && ScheduledMoves.Num() > 0)
+		{
+			FGoKartMove& Front = ScheduledMoves[0];
+			const float Taken = FMath::Min(Remaining, Front.DeltaTime);
+			Front.DeltaTime -= Taken;
+			Remaining -= Taken;
+			TimeIntoNextMove += Taken;
+			if (Front.DeltaTime <= KINDA_SMALL_NUMBER)
+			{
+				PopScheduledMove();
+			}
+		}
+	}
+
+	Super::UpdateSimulation(DeltaTime);
+}
+
+void UNetworkRacersVehicleMovementComponent::PopScheduledMove()
+{
+	// Every step of a move is scheduled on its own, so the move is finished with its last step
+	const uint32 MoveId = ScheduledMoves[0].MoveId;
+	ScheduledMoves.RemoveAt(0, 1, false);
+	if (ScheduledMoves.Num() == 0 || ScheduledMoves[0].MoveId != MoveId)
+	{
+		CompletedMoveId = MoveId;
+		TimeIntoNextMove = 0.f;
+	}
+}
+
+uint32 UNetworkRacersVehicleMovementComponent::GetCompletedMoveId(float& OutTimeIntoNextMove) const
+{
+	OutTimeIntoNextMove = TimeIntoNextMove;
+	return CompletedMoveId;
+}
+
+void UNetworkRacersVehicleMovementComponent::ApplyMoveInput(const FGoKartMove& Move)
+{
+	SetThrottleInput(Move.Throttle);
+	SetSteeringInput(Move.SteeringThrow);
+	SetHandbrakeInput(Move.bHandbrake);
+
+	// PhysX doesn't update vehicles whose body is asleep, so input has to wake it
+	const bool bHasInput = Move.Throttle != 0.f || Move.SteeringThrow != 0.f || Move.bHandbrake;
+	if (bHasInput && UpdatedPrimitive != nullptr && UpdatedPrimitive->IsSimulatingPhysics() && !UpdatedPrimitive->RigidBodyIsAwake())
+	{
+		UpdatedPrimitive->WakeAllRigidBodies();
+	}
+}
+
+bool UNetworkRacersVehicleMovementComponent::IsAsleep() const
+{
+	// PhysX puts the body to sleep once it has settled, and wakes it when something hits it. Moves still to be applied will wake it too
+	return ScheduledMoves.Num() == 0 && UpdatedPrimitive != nullptr && UpdatedPrimitive->IsSimulatingPhysics() && !UpdatedPrimitive->RigidBodyIsAwake();
+}
+
+void UNetworkRacersVehicleMovementComponent::GoToSleep()
+{
+	if (UpdatedPrimitive != nullptr && UpdatedPrimitive->IsSimulatingPhysics())
+	{
+		UpdatedPrimitive->PutAllRigidBodiesToSleep();
+	}
+}
+
+void UNetworkRacersVehicleMovementComponent::SimulateMove(const FGoKartMove& Move)
+{
+	// Don't let the schedule grow if physics isn't stepping the vehicle
+	float ScheduledTime = 0.f;
+	for (const FGoKartMove& ScheduledMove : ScheduledMoves)
+	{
+		ScheduledTime += ScheduledMove.DeltaTime;
+	}
+	while (ScheduledMoves.Num() > 0 && ScheduledTime > NetworkRacersVehicleMovement::MaxScheduledTime)
+	{
+		ScheduledTime -= ScheduledMoves[0].DeltaTime;
+		PopScheduledMove();
+	}
+	ScheduledMoves.Add(Move);
+
+	// Vehicles that aren't locally controlled take their input from ReplicatedState, so keep it in step with the newest move
+	if (GetOwnerRole() == ROLE_Authority)
+	{
+		ApplyMoveInput(Move);
+		ReplicatedState.SteeringInput = CalcSteeringInput();
+		ReplicatedState.ThrottleInput = CalcThrottleInput();
+		ReplicatedState.BrakeInput = CalcBrakeInput();
+		ReplicatedState.HandbrakeInput = CalcHandbrakeInput();
+	}
+}
+
+FGoKartTuning UNetworkRacersVehicleMovementComponent::GetReplayTuning(const FGoKartMove& Move)
+{
+	FGoKartTuning Tuning;
+	Tuning.Mass = Mass;
+
+	// Air resistance is half the air density times the drag coefficient times the frontal area, with the chassis in cm
+	Tuning.DragCoefficient = 0.5f * NetworkRacersVehicleMovement::AirDensity * DragCoefficient * (ChassisWidth / 100.f) * (ChassisHeight / 100.f);
+
+	const UVehicleWheel* Wheel = Wheels.Num() > 0 ? Wheels[0] : nullptr;
+	if (Wheel == nullptr || WheelSetups.Num() < 4)
+	{
+		return Tuning;
+	}
+
+	const float WheelRadius = Wheel->ShapeRadius / 100.f;
+	const float Weight = Mass * FMath::Abs(GetWorld()->GetGravityZ()) / 100.f;
+	const float FrictionScale = (Wheel->TireConfig != nullptr) ? Wheel->TireConfig->GetFrictionScale() : 1.f;
+
+	// Engine torque at its current speed through the current gear. Neutral (eg. at rest) drives off in first, as the auto box does.
+	const int32 Gear = GetCurrentGear();
+	float GearRatio = 0.f;
+	if (Gear < 0)
+	{
+		GearRatio = TransmissionSetup.ReverseGearRatio;
+	}
+	else if (TransmissionSetup.ForwardGears.Num() > 0)
+	{
+		GearRatio = TransmissionSetup.ForwardGears[FMath::Clamp(Gear - 1, 0, TransmissionSetup.ForwardGears.Num() - 1)].Ratio;
+	}
+	const FRichCurve* TorqueCurve = EngineSetup.TorqueCurve.GetRichCurveConst();
+	const float EngineTorque = (TorqueCurve != nullptr) ? TorqueCurve->Eval(GetEngineRotationSpeed()) : 0.f;
+
+	// The tyres can't put down more than they grip
+	const float WheelForce = EngineTorque * FMath::Abs(GearRatio) * TransmissionSetup.FinalRatio / WheelRadius;
+	Tuning.MaxDrivingForce = FMath::Min(WheelForce, Weight * FrictionScale);
+
+	// The front wheels at full lock turn the car about the rear axle
+	const float Wheelbase = FMath::Abs(GetWheelRestingPosition(WheelSetups[0]).X - GetWheelRestingPosition(WheelSetups[2]).X) / 100.f;
+	float MaxSteerAngle = 0.f;
+	for (const UVehicleWheel* VehicleWheel : Wheels)
+	{
+		MaxSteerAngle = FMath::Max(MaxSteerAngle, VehicleWheel->SteerAngle);
+	}
+	if (MaxSteerAngle > KINDA_SMALL_NUMBER && Wheelbase > KINDA_SMALL_NUMBER)
+	{
+		Tuning.MinTurningRadius = Wheelbase / FMath::Sin(FMath::DegreesToRadians(MaxSteerAngle));
+	}
+
+	// Rolling resistance of the tyres, plus the handbrake's torque at the wheels it locks, up to what the tyres grip
+	Tuning.RollingResistanceCoefficient = NetworkRacersVehicleMovement::RollingResistanceCoefficient;
+	if (Move.bHandbrake && Weight > KINDA_SMALL_NUMBER)
+	{
+		float HandbrakeForce = 0.f;
+		for (const UVehicleWheel* VehicleWheel : Wheels)
+		{
+			if (VehicleWheel->bAffectedByHandbrake)
+			{
+				HandbrakeForce += VehicleWheel->MaxHandBrakeTorque / (VehicleWheel->ShapeRadius / 100.f);
+			}
+		}
+		Tuning.RollingResistanceCoefficient += FMath::Min(HandbrakeForce / Weight, FrictionScale);
+	}
+
+	return Tuning;
+}
+
+void UNetworkRacersVehicleMovementComponent::ReplayMove(const FGoKartMove& Move)
+{
+	if (UpdatedPrimitive == nullptr)
+	{
+		return;
+	}
+
+	AActor* Owner = GetOwner();
+	const GoKartSimulation::FKernel Kernel = GoKartSimulation::GetKernel(EGoKartVehicleClass::Standard);
+	const FGoKartTuning Tuning = GetReplayTuning(Move);
+	const float GravityZ = GetWorld()->GetGravityZ();
+
+	FGoKartSimState State;
+	State.Velocity = UpdatedPrimitive->GetPhysicsLinearVelocity() / 100.f;
+
+	const int32 NumSubsteps = FMath::Max(1, FMath::CeilToInt(Move.DeltaTime / FMath::Max(MaxReplaySubstepTime, KINDA_SMALL_NUMBER)));
+	FGoKartMove Substep = Move;
+	Substep.DeltaTime = Move.DeltaTime / NumSubsteps;
+
+	FQuat SubstepRotation = FQuat::Identity;
+	for (int32 Index = 0; Index < NumSubsteps; ++Index)
+	{
+		State.Location = Owner->GetActorLocation();
+		State.Rotation = Owner->GetActorQuat();
+		const FQuat StartRotation = State.Rotation;
+
+		// The kart model drives the move's input, standing in for the tyres
+		Kernel(State, Substep, Tuning, GravityZ);
+		SubstepRotation = State.Rotation * StartRotation.Inverse();
+
+		Owner->SetActorRotation(State.Rotation, ETeleportType::TeleportPhysics);
+
+		FHitResult Hit;
+		Owner->AddActorWorldOffset(State.Location - Owner->GetActorLocation(), true, &Hit, ETeleportType::TeleportPhysics);
+		if (Hit.IsValidBlockingHit())
+		{
+			State.Velocity = FVector::VectorPlaneProject(State.Velocity, Hit.ImpactNormal);
+		}
+	}
+
+	// Hand the live simulation the velocity and turn rate the replay ended with
+	FVector Axis;
+	float Angle;
+	SubstepRotation.ToAxisAndAngle(Axis, Angle);
+	UpdatedPrimitive->SetPhysicsLinearVelocity(State.Velocity * 100.f);
+	UpdatedPrimitive->SetPhysicsAngularVelocityInDegrees(Axis * FMath::RadiansToDegrees(Angle) / FMath::Max(Substep.DeltaTime, KINDA_SMALL_NUMBER));
+
+	// Leave the replayed input applied so the live simulation continues with it
+	ApplyMoveInput(Move);
+}
+
+FVector UNetworkRacersVehicleMovementComponent::GetVelocity() const
+{
+	// The replicator works in m/s, PhysX in cm/s
+	return (UpdatedPrimitive != nullptr) ? UpdatedPrimitive->GetPhysicsLinearVelocity() / 100.f : FVector::ZeroVector;
+}
+
+void UNetworkRacersVehicleMovementComponent::ResetMovement()
+{
+	SetThrottleInput(0.f);
+	SetSteeringInput(0.f);
+	SetHandbrakeInput(false);
+
+	PrevMove = FGoKartMove();
+	PrevMove.Throttle = 0.f;
+	PrevMove.SteeringThrow = 0.f;
+	PrevMove.DeltaTime = 0.f;
+
+	ScheduledMoves.Reset();
+	CompletedMoveId = 0;
+	TimeIntoNextMove = 0.f;
+
+	StopMovementImmediately();
+	SetVelocity(FVector::ZeroVector);
+}
+
+void UNetworkRacersVehicleMovementComponent::SetVelocity(FVector Val)
+{
+	if (UpdatedPrimitive != nullptr)
+	{
+		UpdatedPrimitive->SetPhysicsLinearVelocity(Val * 100.f);
+	}
+}
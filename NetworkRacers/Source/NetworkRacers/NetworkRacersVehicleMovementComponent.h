@@ -0,0 +1,80 @@
+// Copyright 1998-2018 Epic Games, Inc. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "WheeledVehicleMovementComponent4W.h"
+#include "Vehicle/GoKartMovementInterface.h"
+#include "Vehicle/GoKartSimulation.h"
+#include "NetworkRacersVehicleMovementComponent.generated.h"
+
+/**
+ * 4W PhysX vehicle movement that can be driven by UGoKartMovementReplicator, so the vehicle gets the same
+ * input moves, server acknowledgements and replay of pending moves as the go-kart.
+ *
+ * PhysX steps every body in the scene together, so a single vehicle can't be re-simulated on its own.
+ * Pending moves are instead replayed with the go-kart's force model (see GoKartSimulation), driven by each move's
+ * throttle, steering and handbrake from the acknowledged server state. Its tuning comes from this vehicle's setup:
+ * engine torque at the current engine speed through the current gear, limited by tyre grip, the turning circle of the
+ * wheelbase at full lock and the handbrake torque. Gear changes, wheel slip and suspension aren't modelled, so the
+ * replay approximates the server's simulation rather than matching it, and the next acknowledgement corrects the rest.
+ *
+ * On the server, a move's input is held for the move's DeltaTime of physics substeps before the next one is applied,
+ * and the move is acknowledged once physics has finished it, see SimulatesDuringPhysics.
+ * Input only reaches the server as moves, so the engine's own ServerUpdateState RPC isn't sent.
+ */
+UCLASS()
+class UNetworkRacersVehicleMovementComponent : public UWheeledVehicleMovementComponent4W, public IGoKartMovementInterface
+{
+	GENERATED_BODY()
+
+public:
+	UNetworkRacersVehicleMovementComponent();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	virtual void UpdateState(float DeltaTime) override;
+	virtual void UpdateSimulation(float DeltaTime) override;
+
+public:
+
+	// Begin IGoKartMovementInterface
+	virtual FGoKartMove GetPrevMove() const override { return PrevMove; }
+	virtual void SimulateMove(const FGoKartMove& Move) override;
+	virtual void ReplayMove(const FGoKartMove& Move) override;
+	virtual FVector GetVelocity() const override;
+	virtual void SetVelocity(FVector Val) override;
+	virtual void ResetMovement() override;
+	virtual bool SimulatesDuringPhysics() const override { return true; }
+	virtual bool IsAsleep() const override;
+	virtual void GoToSleep() override;
+	virtual uint32 GetCompletedMoveId(float& OutTimeIntoNextMove) const override;
+	// End IGoKartMovementInterface
+
+	/** Longest step (s) used when replaying a pending move */
+	UPROPERTY(EditAnywhere, Category = Replication)
+	float MaxReplaySubstepTime = 1.f / 60.f;
+
+private:
+	/** Set the vehicle's input from a move, and on the server the state replicated to other clients */
+	void ApplyMoveInput(const FGoKartMove& Move);
+
+	/** Handling of the replay model for a move, from the vehicle's setup and its engine speed and gear now */
+	FGoKartTuning GetReplayTuning(const FGoKartMove& Move);
+
+	/** Remove the front of ScheduledMoves, noting the move as completed if it was its last step */
+	void PopScheduledMove();
+
+	/**
+	 * Server: moves waiting to be applied, front first, each with the time it has left (s).
+	 * Written on the game thread before physics starts, and consumed by UpdateSimulation once per physics substep.
+	 */
+	TArray<FGoKartMove> ScheduledMoves;
+
+	/** Server: newest move whose steps physics has all applied, and the time applied of the moves after it (s) */
+	uint32 CompletedMoveId = 0;
+	float TimeIntoNextMove = 0.f;
+
+	FGoKartMove PrevMove;
+};
@@ -4,7 +4,7 @@
 
 #include "Components/InputComponent.h"
 #include "Engine/World.h"
-#include "DrawDebugHelpers.h"
+#include "NetworkRacersGameMode.h"
 
 
 AGoKart::AGoKart()
@@ -19,6 +19,33 @@ AGoKart::AGoKart()
 
 }
 
+bool AGoKart::IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const
+{
+	// Karts are only replicated within their race, and players joining mid-race receive them a few at a time.
+	if (!MovementReplicator->IsAdmittedFor(RealViewer)) return false;
+
+	return Super::IsNetRelevantFor(RealViewer, ViewTarget, SrcLocation);
+
+}
+
+void AGoKart::FellOutOfWorld(const UDamageType& DamageType)
+{
+	// Karts are pooled, so rather than being destroyed one that falls off the track goes back to the pool and is replaced.
+	// Clients leave it to the server.
+	if (!HasAuthority()) return;
+
+	ANetworkRacersGameMode* GameMode = GetWorld()->GetAuthGameMode<ANetworkRacersGameMode>();
+	if (GameMode == nullptr)
+	{
+		Super::FellOutOfWorld(DamageType);
+		return;
+
+	}
+
+	GameMode->RespawnPawn(this);
+
+}
+
 void AGoKart::BeginPlay()
 {
 	Super::BeginPlay();
@@ -40,33 +67,6 @@ void AGoKart::BeginPlay()
 	
 }
 
-FString GetEnumText(ENetRole Role)
-{
-	// Used to visualize remote roles of actors.
-	switch (Role)
-	{
-	case ROLE_None:
-		return "None";
-	case ROLE_SimulatedProxy:
-		return "SimulatedProxy";
-	case ROLE_AutonomousProxy:
-		return "AutonomousProxy";
-	case ROLE_Authority:
-		return "Authority";
-	default:
-		return "ERROR";
-	}
-
-}
-
-void AGoKart::Tick(float DeltaTime)
-{
-	Super::Tick(DeltaTime);
-
-	DrawDebugString(GetWorld(), FVector(0.f, 0.f, 100.f), GetEnumText(Role), this, FColor::White, DeltaTime);
-
-}
-
 void AGoKart::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent)
 {
 	Super::SetupPlayerInputComponent(PlayerInputComponent);
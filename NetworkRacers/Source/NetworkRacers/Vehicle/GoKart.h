@@ -17,10 +17,12 @@ class NETWORKRACERS_API AGoKart : public APawn
 public:
 	AGoKart();
 
-	virtual void Tick(float DeltaTime) override;
-
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 
+	virtual bool IsNetRelevantFor(const AActor* RealViewer, const AActor* ViewTarget, const FVector& SrcLocation) const override;
+
+	virtual void FellOutOfWorld(const class UDamageType& DamageType) override;
+
 protected:
 	virtual void BeginPlay() override;
 
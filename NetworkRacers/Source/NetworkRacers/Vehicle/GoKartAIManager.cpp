@@ -0,0 +1,236 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartAIManager.h"
+#include "GoKartMovementComponent.h"
+#include "GoKartMovementReplicator.h"
+#include "Components/SplineComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+
+
+namespace GoKartAIManager
+{
+	// Spacing of the samples when first finding a bot on the racing line (cm).
+	const float CoarseSearchStep = 1000.f;
+
+	// Refinement steps projecting a bot onto the racing line.
+	const int32 ProjectionIterations = 2;
+}
+
+AGoKartAIManager::AGoKartAIManager()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	bReplicates = false;
+
+	RacingLine = nullptr;
+	bSearchedForRacingLine = false;
+	TimeSinceDecision = 0.f;
+
+}
+
+USplineComponent* AGoKartAIManager::GetRacingLine()
+{
+	if (!bSearchedForRacingLine)
+	{
+		bSearchedForRacingLine = true;
+		for (TActorIterator<AActor> It(GetWorld()); It && RacingLine == nullptr; ++It)
+		{
+			if (It->ActorHasTag(RacingLineTag))
+			{
+				RacingLine = It->FindComponentByClass<USplineComponent>();
+
+			}
+
+		}
+		if (RacingLine == nullptr)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("No actor with a spline tagged %s, races won't get bots."), *RacingLineTag.ToString());
+
+		}
+
+	}
+
+	return RacingLine;
+
+}
+
+bool AGoKartAIManager::HasRacingLine()
+{
+	return GetRacingLine() != nullptr;
+
+}
+
+float AGoKartAIManager::WrapDistance(float Distance) const
+{
+	const float Length = RacingLine->GetSplineLength();
+	if (Length <= 0.f) return 0.f;
+
+	return RacingLine->IsClosedLoop() ? FMath::Fmod(FMath::Fmod(Distance, Length) + Length, Length) : FMath::Clamp(Distance, 0.f, Length);
+
+}
+
+FTransform AGoKartAIManager::GetStartTransform(int32 SlotIndex, const FVector& Origin)
+{
+	if (GetRacingLine() == nullptr) return FTransform(Origin);
+
+	// Two columns, rows going back from the start of the line.
+	const float Distance = WrapDistance(-GridRowSpacing * (SlotIndex / 2 + 1));
+	const float Side = (SlotIndex % 2 == 0 ? -0.5f : 0.5f) * GridColumnSpacing;
+
+	const FVector Location = RacingLine->GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+	const FRotator Rotation = RacingLine->GetRotationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+	const FVector Right = RacingLine->GetRightVectorAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+
+	return FTransform(FRotator(0.f, Rotation.Yaw, 0.f), Origin + Location + Right * Side);
+
+}
+
+bool AGoKartAIManager::AddBot(APawn* Kart, const FVector& Origin)
+{
+	if (Kart == nullptr || GetRacingLine() == nullptr) return false;
+
+	FGoKartAIBot Bot;
+	Bot.Movement = Kart->FindComponentByClass<UGoKartMovementComponent>();
+	Bot.Replicator = Kart->FindComponentByClass<UGoKartMovementReplicator>();
+	Bot.Origin = Origin;
+	if (Bot.Movement == nullptr) return false;
+
+	// Find roughly where the bot is along the whole line, then refine.
+	const FVector Location = Kart->GetActorLocation() - Origin;
+	float ClosestDistanceSquared = MAX_flt;
+	for (float Distance = 0.f; Distance < RacingLine->GetSplineLength(); Distance += GoKartAIManager::CoarseSearchStep)
+	{
+		const float DistanceSquared = FVector::DistSquared(Location, RacingLine->GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World));
+		if (DistanceSquared < ClosestDistanceSquared)
+		{
+			ClosestDistanceSquared = DistanceSquared;
+			Bot.Distance = Distance;
+
+		}
+
+	}
+	Bot.Distance = TrackDistance(Location, Bot.Distance);
+
+	SetKartTicksEnabled(Bot, false);
+	Bots.Add(Bot);
+	return true;
+
+}
+
+void AGoKartAIManager::RemoveBot(APawn* Kart)
+{
+	for (int32 Index = Bots.Num() - 1; Index >= 0; --Index)
+	{
+		if (Bots[Index].Movement == nullptr || Bots[Index].Movement->GetOwner() == Kart)
+		{
+			SetKartTicksEnabled(Bots[Index], true);
+			Bots.RemoveAtSwap(Index);
+
+		}
+
+	}
+
+}
+
+void AGoKartAIManager::SetKartTicksEnabled(const FGoKartAIBot& Bot, bool bEnabled)
+{
+	if (Bot.Movement == nullptr || Bot.Movement->GetOwner() == nullptr) return;
+
+	Bot.Movement->GetOwner()->SetActorTickEnabled(bEnabled);
+	Bot.Movement->SetComponentTickEnabled(bEnabled);
+	if (Bot.Replicator != nullptr)
+	{
+		Bot.Replicator->SetComponentTickEnabled(bEnabled);
+
+	}
+
+}
+
+float AGoKartAIManager::TrackDistance(const FVector& Location, float Distance) const
+{
+	// Slide along the line by how far the bot is ahead of or behind the point it was at.
+	for (int32 Iteration = 0; Iteration < GoKartAIManager::ProjectionIterations; ++Iteration)
+	{
+		const FVector Point = RacingLine->GetLocationAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+		const FVector Direction = RacingLine->GetDirectionAtDistanceAlongSpline(Distance, ESplineCoordinateSpace::World);
+		Distance = WrapDistance(Distance + FVector::DotProduct(Location - Point, Direction));
+
+	}
+
+	return Distance;
+
+}
+
+void AGoKartAIManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (RacingLine == nullptr) return;
+
+	const float DecisionInterval = DecisionRate > 0.f ? 1.f / DecisionRate : 0.f;
+	TimeSinceDecision += DeltaTime;
+	const bool bDecide = TimeSinceDecision >= DecisionInterval;
+	if (bDecide)
+	{
+		TimeSinceDecision = DecisionInterval > 0.f ? FMath::Fmod(TimeSinceDecision, DecisionInterval) : 0.f;
+
+	}
+
+	// One pass over every bot. Karts that were destroyed rather than removed are dropped on the way.
+	for (int32 Index = Bots.Num() - 1; Index >= 0; --Index)
+	{
+		FGoKartAIBot& Bot = Bots[Index];
+		if (Bot.Movement == nullptr || Bot.Movement->IsPendingKill() || Bot.Movement->GetOwner() == nullptr)
+		{
+			Bots.RemoveAtSwap(Index);
+			continue;
+
+		}
+
+		if (bDecide)
+		{
+			Decide(Bot);
+
+		}
+
+		// What the kart's own ticks would have done.
+		Bot.Movement->SimulateLocalMove(DeltaTime);
+		if (Bot.Replicator != nullptr)
+		{
+			Bot.Replicator->UpdateServerDrivenState();
+
+		}
+
+	}
+
+}
+
+void AGoKartAIManager::Decide(FGoKartAIBot& Bot) const
+{
+	const AActor* Kart = Bot.Movement->GetOwner();
+	const FVector Location = Kart->GetActorLocation() - Bot.Origin;
+	const FVector Forward = Kart->GetActorForwardVector();
+	const FVector Right = Kart->GetActorRightVector();
+
+	Bot.Distance = TrackDistance(Location, Bot.Distance);
+
+	// Steer towards a point ahead on the line. Positive steering turns right.
+	const FVector Target = RacingLine->GetLocationAtDistanceAlongSpline(WrapDistance(Bot.Distance + SteeringLookAhead), ESplineCoordinateSpace::World);
+	const FVector ToTarget = Target - Location;
+	const float AngleToTarget = FMath::Atan2(FVector::DotProduct(ToTarget, Right), FVector::DotProduct(ToTarget, Forward));
+	const float Steering = FMath::Clamp(AngleToTarget / FMath::DegreesToRadians(FMath::Max(FullLockAngle, 1.f)), -1.f, 1.f);
+
+	// Slow down by how sharply the line turns ahead.
+	const FVector DirectionNow = RacingLine->GetDirectionAtDistanceAlongSpline(Bot.Distance, ESplineCoordinateSpace::World);
+	const FVector DirectionAhead = RacingLine->GetDirectionAtDistanceAlongSpline(WrapDistance(Bot.Distance + CornerLookAhead), ESplineCoordinateSpace::World);
+	const float CornerAngle = FMath::Acos(FMath::Clamp(FVector::DotProduct(DirectionNow, DirectionAhead), -1.f, 1.f));
+	const float TargetSpeed = FMath::Lerp(StraightSpeed, CornerSpeed, FMath::Clamp(CornerAngle / HALF_PI, 0.f, 1.f));
+
+	const float ForwardSpeed = FVector::DotProduct(Bot.Movement->GetVelocity(), Forward);
+	const float Throttle = FMath::Clamp((TargetSpeed - ForwardSpeed) * SpeedGain, -1.f, 1.f);
+
+	Bot.Movement->SetThrottle(Throttle);
+	Bot.Movement->SetSteeringThrow(Steering);
+
+}
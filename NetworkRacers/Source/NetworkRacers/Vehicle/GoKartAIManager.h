@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "GoKartAIManager.generated.h"
+
+class USplineComponent;
+class UGoKartMovementComponent;
+class UGoKartMovementReplicator;
+
+
+USTRUCT()
+struct FGoKartAIBot
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	UGoKartMovementComponent* Movement = nullptr;
+
+	UPROPERTY()
+	UGoKartMovementReplicator* Replicator = nullptr;
+
+	// Origin of the bot's race instance, the racing line is offset by it.
+	FVector Origin = FVector::ZeroVector;
+
+	// How far along the racing line the bot was at the last decision (cm).
+	float Distance = 0.f;
+
+};
+
+/**
+* Drives the server's bot karts, which fill the empty slots of a race (see ANetworkRacersGameMode::MaxBotsPerRace).
+*
+* Bots are ordinary karts with no controller, replicated like any kart the server drives. Their own actor and component
+* ticks are switched off while they are bots: every frame this simulates each bot's move and publishes its state in a
+* single pass, so a bot costs its simulation and sweep and nothing for tick dispatch. Decisions are made for every bot
+* at once at DecisionRate, and the inputs are held in between.
+*
+* Bots follow the spline of an actor tagged RacingLineTag, which belongs in the persistent level next to the player
+* starts and is offset to each race instance. With no racing line there are no bots.
+*
+*/
+UCLASS(NotPlaceable, Transient, Config = Game)
+class NETWORKRACERS_API AGoKartAIManager : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartAIManager();
+
+	virtual void Tick(float DeltaTime) override;
+
+	bool HasRacingLine();
+
+	// Where the SlotIndex'th bot of the race at Origin starts: on a grid back from the start of the racing line.
+	FTransform GetStartTransform(int32 SlotIndex, const FVector& Origin);
+
+	// Start driving Kart, which needs a UGoKartMovementComponent. Returns false if it can't be driven.
+	bool AddBot(APawn* Kart, const FVector& Origin);
+
+	void RemoveBot(APawn* Kart);
+
+protected:
+	// Bot decisions per second. Inputs are held between decisions.
+	UPROPERTY(Config, EditDefaultsOnly, Category = "AI")
+	float DecisionRate = 10.f;
+
+	UPROPERTY(Config, EditDefaultsOnly, Category = "AI")
+	FName RacingLineTag = TEXT("RacingLine");
+
+	// How far ahead along the racing line bots steer towards (cm).
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float SteeringLookAhead = 1500.f;
+
+	// How far ahead bots look for corners to slow down for (cm).
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float CornerLookAhead = 3000.f;
+
+	// Angle to the steering target that takes full steering lock (deg).
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float FullLockAngle = 30.f;
+
+	// Target speed on straights, and approaching a right-angle corner (m/s).
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float StraightSpeed = 22.f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float CornerSpeed = 10.f;
+
+	// Throttle per m/s of difference from the target speed.
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float SpeedGain = 0.5f;
+
+	// Distance between rows of the starting grid, and between its two columns (cm).
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float GridRowSpacing = 800.f;
+
+	UPROPERTY(EditDefaultsOnly, Category = "AI")
+	float GridColumnSpacing = 400.f;
+
+private:
+	USplineComponent* GetRacingLine();
+
+	float WrapDistance(float Distance) const;
+
+	// Distance along the racing line closest to Location, searching near Distance.
+	float TrackDistance(const FVector& Location, float Distance) const;
+
+	void Decide(FGoKartAIBot& Bot) const;
+
+	// Switch the kart's own ticks, which the manager stands in for while it is a bot.
+	static void SetKartTicksEnabled(const FGoKartAIBot& Bot, bool bEnabled);
+
+	UPROPERTY()
+	USplineComponent* RacingLine;
+
+	bool bSearchedForRacingLine;
+
+	float TimeSinceDecision;
+
+	UPROPERTY()
+	TArray<FGoKartAIBot> Bots;
+
+};
@@ -0,0 +1,137 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartClockSync.h"
+#include "HAL/PlatformTime.h"
+
+
+namespace GoKartClockSync
+{
+	// Seconds between exchanges while getting the first estimate, and afterwards.
+	const double InitialSampleInterval = 0.2;
+	const double SampleInterval = 2.0;
+
+	// Fastest the applied offset is slewed (seconds of correction per second).
+	const double MaxSlewRate = 0.05;
+
+	// Errors larger than this are stepped rather than slewed, eg. after a long server hitch.
+	const double MaxSlewError = 0.25;
+}
+
+int64 GoKartTime::GetSessionTicks()
+{
+	static const double SessionEpoch = FPlatformTime::Seconds();
+	return GoKartTime::SecondsToTicks(FPlatformTime::Seconds() - SessionEpoch);
+
+}
+
+FGoKartClockSync::FGoKartClockSync()
+	: NextSample(0)
+	, NumSamplesReceived(0)
+	, LastSampleSentTime(-DBL_MAX)
+	, TargetOffset(0.0)
+	, AppliedOffset(0.0)
+	, bHasEstimate(false)
+	, RoundTripTime(0.f)
+	, LastServerTime(-DBL_MAX)
+{
+	Samples.Reserve(MaxSamples);
+
+}
+
+bool FGoKartClockSync::WantsSample(double LocalTime) const
+{
+	const double Interval = NumSamplesReceived < InitialSamples ? GoKartClockSync::InitialSampleInterval : GoKartClockSync::SampleInterval;
+	return LocalTime - LastSampleSentTime >= Interval;
+
+}
+
+void FGoKartClockSync::NoteSampleSent(double LocalTime)
+{
+	LastSampleSentTime = LocalTime;
+
+}
+
+void FGoKartClockSync::AddSample(double ClientSendTime, double ServerTime, double ClientReceiveTime)
+{
+	const double SampleRoundTripTime = ClientReceiveTime - ClientSendTime;
+	if (SampleRoundTripTime < 0.0) return;
+
+	/**
+	* Assume the request and reply took equally long, so the server read its clock half an RTT before we received it.
+	* Offset is what we add to our clock to get the server's.
+	*
+	*/
+	FSample Sample;
+	Sample.RoundTripTime = SampleRoundTripTime;
+	Sample.Offset = ServerTime + SampleRoundTripTime / 2 - ClientReceiveTime;
+
+	if (Samples.Num() < MaxSamples)
+	{
+		Samples.Add(Sample);
+
+	}
+	else
+	{
+		Samples[NextSample] = Sample;
+
+	}
+	NextSample = (NextSample + 1) % MaxSamples;
+	++NumSamplesReceived;
+
+	UpdateEstimate();
+
+}
+
+void FGoKartClockSync::UpdateEstimate()
+{
+	TArray<FSample> Sorted = Samples;
+	Sorted.Sort([](const FSample& A, const FSample& B) { return A.RoundTripTime < B.RoundTripTime; });
+
+	// Median RTT of the whole window is robust against the odd spike.
+	RoundTripTime = Sorted[Sorted.Num() / 2].RoundTripTime;
+
+	// Outlier rejection: only the fastest half of the exchanges is used for the offset, and the median of those taken.
+	const int32 NumTrusted = FMath::Max(1, Sorted.Num() / 2);
+	TArray<double> Offsets;
+	Offsets.Reserve(NumTrusted);
+	for (int32 Index = 0; Index < NumTrusted; ++Index)
+	{
+		Offsets.Add(Sorted[Index].Offset);
+
+	}
+	Offsets.Sort();
+	TargetOffset = Offsets[Offsets.Num() / 2];
+
+	if (!bHasEstimate)
+	{
+		AppliedOffset = TargetOffset;
+		bHasEstimate = true;
+
+	}
+
+}
+
+void FGoKartClockSync::Tick(float DeltaTime)
+{
+	if (!bHasEstimate) return;
+
+	const double Error = TargetOffset - AppliedOffset;
+	if (FMath::Abs(Error) > GoKartClockSync::MaxSlewError)
+	{
+		AppliedOffset = TargetOffset;
+		return;
+
+	}
+
+	const double MaxCorrection = GoKartClockSync::MaxSlewRate * DeltaTime;
+	AppliedOffset += FMath::Clamp(Error, -MaxCorrection, MaxCorrection);
+
+}
+
+double FGoKartClockSync::GetServerTime(double LocalTime) const
+{
+	// Slewing (or stepping) backwards must never make the clock run backwards, so hold until it catches up.
+	LastServerTime = FMath::Max(LastServerTime, LocalTime + AppliedOffset);
+	return LastServerTime;
+
+}
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+* Session clock used for move timing and clock synchronization.
+*
+* A 32-bit float of world seconds drops to millisecond resolution after a few hours of uptime, so time is kept as
+* 64-bit microsecond ticks since this process first asked for it. That stays exact for far longer than any server runs.
+*
+*/
+namespace GoKartTime
+{
+	const int64 TicksPerSecond = 1000000;
+
+	NETWORKRACERS_API int64 GetSessionTicks();
+
+	inline double TicksToSeconds(int64 Ticks) { return static_cast<double>(Ticks) / TicksPerSecond; };
+	inline int64 SecondsToTicks(double Seconds) { return static_cast<int64>(Seconds * TicksPerSecond); };
+}
+
+/**
+* NTP-style estimate of the server's clock, kept on the client.
+*
+* The client periodically sends its local time, the server echoes it along with its own time, and each exchange gives
+* a round trip time (RTT) and a clock offset: ServerTime + RTT / 2 - ClientReceiveTime.
+* Exchanges that took longest are the ones most likely to have been delayed in one direction only, so only the
+* lowest-RTT samples in the window are trusted. The applied offset slews towards the estimate rather than stepping,
+* and the synchronized clock never runs backwards.
+*
+*/
+class NETWORKRACERS_API FGoKartClockSync
+{
+public:
+	FGoKartClockSync();
+
+	// Whether it's time to send another sync request.
+	bool WantsSample(double LocalTime) const;
+	void NoteSampleSent(double LocalTime);
+
+	// Record a completed exchange. All times in seconds.
+	void AddSample(double ClientSendTime, double ServerTime, double ClientReceiveTime);
+
+	// Slew the applied offset towards the estimate.
+	void Tick(float DeltaTime);
+
+	bool HasEstimate() const { return bHasEstimate; };
+
+	// Monotonic estimate of the server clock at LocalTime.
+	double GetServerTime(double LocalTime) const;
+
+	// Estimated round trip time (s).
+	float GetRoundTripTime() const { return RoundTripTime; };
+
+private:
+	void UpdateEstimate();
+
+	struct FSample
+	{
+		double Offset;
+		double RoundTripTime;
+	};
+
+	// Window of recent exchanges (ring buffer).
+	static const int32 MaxSamples = 16;
+	TArray<FSample> Samples;
+	int32 NextSample;
+
+	// Exchanges sent quickly after connecting to get an estimate, then at a steady rate to follow drift.
+	static const int32 InitialSamples = 5;
+	int32 NumSamplesReceived;
+	double LastSampleSentTime;
+
+	double TargetOffset;
+	double AppliedOffset;
+	bool bHasEstimate;
+
+	float RoundTripTime;
+
+	mutable double LastServerTime;
+
+};
@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartGhost.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "Engine/SkeletalMesh.h"
+#include "Async/Async.h"
+
+
+AGoKartGhost::AGoKartGhost()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	KartMeshAsset = TSoftObjectPtr<USkeletalMesh>(FSoftObjectPath(TEXT("/Game/Vehicle/Sedan/Sedan_SkelMesh.Sedan_SkelMesh")));
+
+	Mesh = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("Mesh"));
+	Mesh->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Mesh->bGenerateOverlapEvents = false;
+	Mesh->SetCastShadow(false);
+	RootComponent = Mesh;
+
+	CurrentChunkStart = 0;
+	PlaybackTime = 0.f;
+	SampleInterval = 0.f;
+	bReadAll = false;
+
+}
+
+void AGoKartGhost::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (Mesh->SkeletalMesh == nullptr && !KartMeshAsset.IsNull())
+	{
+		USkeletalMesh* KartMesh = KartMeshAsset.Get();
+		if (KartMesh == nullptr)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s was not preloaded for this map, loading it synchronously."), *KartMeshAsset.ToString());
+			KartMesh = KartMeshAsset.LoadSynchronous();
+
+		}
+		Mesh->SetSkeletalMesh(KartMesh);
+
+	}
+
+	UE_CLOG(Mesh->SkeletalMesh == nullptr, LogTemp, Error, TEXT("%s has no kart mesh and won't be visible. Set KartMeshAsset."), *GetName());
+
+}
+
+void AGoKartGhost::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopPlayback();
+
+	Super::EndPlay(EndPlayReason);
+
+}
+
+bool AGoKartGhost::StartPlayback(const FString& Name)
+{
+	PlaybackFilename = GoKartTrajectory::GetTrajectoryPath(Name);
+	return RestartPlayback();
+
+}
+
+bool AGoKartGhost::RestartPlayback()
+{
+	// The worker may still be using the reader.
+	WaitForRead();
+
+	if (!Reader.Open(PlaybackFilename))
+	{
+		StopPlayback();
+		return false;
+
+	}
+
+	SampleInterval = 1.f / Reader.GetSampleRate();
+	PlaybackTime = 0.f;
+	CurrentChunkStart = 0;
+	NextChunk.Reset();
+	bReadAll = false;
+
+	// The first chunk places the ghost, so it is read straight away. The rest are read on a worker thread.
+	Reader.ReadChunk(CurrentChunk);
+	UpdateRead();
+
+	if (CurrentChunk.Num() == 0)
+	{
+		StopPlayback();
+		return false;
+
+	}
+
+	SetActorLocationAndRotation(CurrentChunk[0].Location, CurrentChunk[0].Rotation);
+	SetActorTickEnabled(true);
+	return true;
+
+}
+
+void AGoKartGhost::StopPlayback()
+{
+	WaitForRead();
+	Reader.Close();
+	CurrentChunk.Empty();
+	NextChunk.Empty();
+	SetActorTickEnabled(false);
+
+}
+
+void AGoKartGhost::UpdateRead()
+{
+	if (PendingRead.IsValid())
+	{
+		if (!PendingRead.IsReady()) return;
+
+		bReadAll = !PendingRead.Get();
+		PendingRead = TFuture<bool>();
+		Swap(NextChunk, ReadingChunk);
+
+	}
+
+	// Only one chunk is read ahead of the one being played.
+	if (NextChunk.Num() == 0 && !bReadAll && Reader.IsOpen())
+	{
+		PendingRead = Async<bool>(EAsyncExecution::ThreadPool, [this]() { return Reader.ReadChunk(ReadingChunk); });
+
+	}
+
+}
+
+void AGoKartGhost::WaitForRead()
+{
+	if (PendingRead.IsValid())
+	{
+		PendingRead.Wait();
+		PendingRead = TFuture<bool>();
+
+	}
+
+}
+
+const FGoKartObserverState* AGoKartGhost::GetSample(int32 SampleIndex) const
+{
+	const int32 Index = SampleIndex - CurrentChunkStart;
+	if (CurrentChunk.IsValidIndex(Index)) return &CurrentChunk[Index];
+	if (NextChunk.IsValidIndex(Index - CurrentChunk.Num())) return &NextChunk[Index - CurrentChunk.Num()];
+	return nullptr;
+
+}
+
+void AGoKartGhost::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	PlaybackTime += DeltaTime;
+	const float SamplePosition = PlaybackTime / SampleInterval;
+	const int32 SampleIndex = FMath::FloorToInt(SamplePosition);
+
+	// Once playback moves into the next chunk, it becomes current and the one after is read in its place.
+	UpdateRead();
+	while (SampleIndex >= CurrentChunkStart + CurrentChunk.Num() && NextChunk.Num() > 0)
+	{
+		CurrentChunkStart += CurrentChunk.Num();
+		Swap(CurrentChunk, NextChunk);
+		NextChunk.Reset();
+		UpdateRead();
+
+	}
+
+	const FGoKartObserverState* Start = GetSample(SampleIndex);
+	const FGoKartObserverState* Target = GetSample(SampleIndex + 1);
+	if ((Start == nullptr || Target == nullptr) && PendingRead.IsValid())
+	{
+		// The next chunk is still being read: hold where we are rather than end early.
+		PlaybackTime -= DeltaTime;
+		return;
+
+	}
+	if (Start == nullptr || Target == nullptr)
+	{
+		// End of the trajectory: start over, or stay on the last sample.
+		if (bLoop)
+		{
+			RestartPlayback();
+
+		}
+		else
+		{
+			StopPlayback();
+
+		}
+		return;
+
+	}
+
+	// Samples are SampleInterval apart, so velocity (m/s) becomes a spline derivative as in UGoKartMovementReplicator::VelocityToDerivative.
+	const float VelocityToDerivative = SampleInterval * 100;
+
+	FHermiteCubicSpline Spline;
+	Spline.StartLocation = Start->Location;
+	Spline.StartDerivative = Start->Velocity * VelocityToDerivative;
+	Spline.TargetLocation = Target->Location;
+	Spline.TargetDerivative = Target->Velocity * VelocityToDerivative;
+
+	const float LerpRatio = SamplePosition - SampleIndex;
+	SetActorLocationAndRotation(Spline.InterpolateLocation(LerpRatio), FQuat::Slerp(Start->Rotation.Quaternion(), Target->Rotation.Quaternion(), LerpRatio));
+
+}
@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GoKartTrajectory.h"
+#include "Async/Future.h"
+#include "GoKartGhost.generated.h"
+
+class USkeletalMesh;
+class USkeletalMeshComponent;
+
+
+/**
+* Plays back a recorded kart trajectory, eg. as a time-trial ghost. Purely local: no collision, physics or replication.
+*
+* The trajectory is streamed from disk a chunk at a time, holding only the chunk being played and the one after it,
+* so memory per ghost stays small and constant however long the recording is. Chunks after the first are read and
+* decoded on a worker thread, so playback never waits on the disk. Between samples the ghost follows the same
+* Hermite spline UGoKartMovementReplicator uses to smooth simulated proxies.
+*
+*/
+UCLASS()
+class NETWORKRACERS_API AGoKartGhost : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartGhost();
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	// Play Saved/Trajectories/<Name>.gktraj from the start.
+	UFUNCTION(BlueprintCallable, Category = "Trajectory")
+	bool StartPlayback(const FString& Name);
+
+	UFUNCTION(BlueprintCallable, Category = "Trajectory")
+	void StopPlayback();
+
+protected:
+	// Start again from the beginning when the trajectory ends, rather than stopping at its last sample.
+	UPROPERTY(EditAnywhere, Category = "Trajectory")
+	bool bLoop = false;
+
+	// Kart mesh shown by the ghost. Defaults to the sedan, which the map's preload manifest streams in.
+	UPROPERTY(EditDefaultsOnly, Category = "Display")
+	TSoftObjectPtr<USkeletalMesh> KartMeshAsset;
+
+private:
+	bool RestartPlayback();
+
+	// Sample by index within the current and next chunk, null past the end of what is loaded.
+	const FGoKartObserverState* GetSample(int32 SampleIndex) const;
+
+	// Collect a finished chunk read, and start reading the next chunk once there is room for it.
+	void UpdateRead();
+
+	void WaitForRead();
+
+	UPROPERTY(VisibleAnywhere)
+	USkeletalMeshComponent* Mesh;
+
+	FGoKartTrajectoryReader Reader;
+	FString PlaybackFilename;
+
+	TArray<FGoKartObserverState> CurrentChunk;
+	TArray<FGoKartObserverState> NextChunk;
+
+	// Owned by the worker thread while PendingRead is valid.
+	TArray<FGoKartObserverState> ReadingChunk;
+	TFuture<bool> PendingRead;
+	bool bReadAll;
+
+	// Index of CurrentChunk[0] in the whole trajectory.
+	int32 CurrentChunkStart;
+
+	float PlaybackTime;
+	float SampleInterval;
+
+};
@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartInputBuffer.h"
+
+
+namespace GoKartInputBuffer
+{
+	// Bounds on the target amount of buffered input (s).
+	const float MinBufferTime = 0.02f;
+	const float MaxBufferTime = 0.2f;
+
+	// Target is this many times the measured arrival jitter.
+	const float JitterScale = 2.f;
+
+	// Weight of each new sample in the jitter estimate, as for RTP interarrival jitter.
+	const float JitterSmoothing = 1.f / 16.f;
+
+	// How far over the target the buffer may get before the excess is drained in a single tick (s).
+	const float OverrunTolerance = 0.1f;
+
+	// Most unspent time kept while the buffer is empty (s), so a kart that ran dry catches up without a burst.
+	const float MaxCarriedBudget = 0.05f;
+}
+
+FGoKartInputBuffer::FGoKartInputBuffer()
+{
+	Reset();
+
+}
+
+void FGoKartInputBuffer::Reset()
+{
+	Moves.Reset();
+	BufferedTime = 0.f;
+	bPrimed = false;
+	LastConsumedMove = FGoKartMove();
+	Budget = 0.f;
+	LastArrivalTime = -1.0;
+	ArrivalJitter = 0.f;
+	TargetBufferTime = GoKartInputBuffer::MinBufferTime;
+
+}
+
+void FGoKartInputBuffer::AddMove(const FGoKartMove& Move, double ArrivalTime)
+{
+	// A client sending steadily delivers moves as fast as they cover time, any difference is jitter.
+	if (LastArrivalTime >= 0.0)
+	{
+		const float Deviation = FMath::Abs(static_cast<float>(ArrivalTime - LastArrivalTime) - Move.GetDuration());
+		ArrivalJitter += (Deviation - ArrivalJitter) * GoKartInputBuffer::JitterSmoothing;
+		TargetBufferTime = FMath::Clamp(ArrivalJitter * GoKartInputBuffer::JitterScale, GoKartInputBuffer::MinBufferTime, GoKartInputBuffer::MaxBufferTime);
+
+	}
+	LastArrivalTime = ArrivalTime;
+
+	Moves.Add(Move);
+	BufferedTime += Move.GetDuration();
+
+}
+
+int32 FGoKartInputBuffer::Consume(float DeltaTime, int32 MaxSteps, TFunctionRef<void(const FGoKartMove&)> Simulate)
+{
+	if (!bPrimed)
+	{
+		if (BufferedTime < TargetBufferTime) return 0;
+		bPrimed = true;
+
+	}
+
+	Budget += DeltaTime;
+	const float SteadyBudget = Budget;
+
+	// Don't let latency build up behind a burst, catch back up to the target this tick.
+	if (BufferedTime - Budget > TargetBufferTime + GoKartInputBuffer::OverrunTolerance)
+	{
+		Budget = BufferedTime - TargetBufferTime;
+
+	}
+
+	int32 Steps = 0;
+	float ConsumedTime = 0.f;
+	while (Moves.Num() > 0 && Moves[0].GetDuration() <= Budget + KINDA_SMALL_NUMBER)
+	{
+		const FGoKartMove& Front = Moves[0];
+		const float Duration = Front.GetDuration();
+		if (Steps >= MaxSteps && ConsumedTime + Duration > SteadyBudget + KINDA_SMALL_NUMBER) break;
+
+		Simulate(Front);
+		Budget -= Duration;
+		ConsumedTime += Duration;
+		BufferedTime = FMath::Max(0.f, BufferedTime - Duration);
+		LastConsumedMove = Front;
+		Moves.RemoveAt(0, 1, false);
+		++Steps;
+
+	}
+
+	// Only this tick's own time carries over, and only a little of it while the kart is waiting on an underrun.
+	Budget = FMath::Clamp(Budget, 0.f, Moves.Num() > 0 ? SteadyBudget : GoKartInputBuffer::MaxCarriedBudget);
+
+	return Steps;
+
+}
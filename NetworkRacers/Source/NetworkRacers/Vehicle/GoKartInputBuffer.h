@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Function.h"
+#include "GoKartMovementInterface.h"
+
+
+/**
+* Server-side jitter buffer for the moves a client sends.
+*
+* Moves arrive in bursts, so simulating them as they arrive runs none for a kart in some ticks and several in others.
+* Instead they are held here and consumed at the rate the server ticks: each tick adds its DeltaTime to a budget and
+* takes as many whole moves as the budget covers, carrying the rest to the next tick. Moves are never sliced or
+* merged, so the server simulates exactly the steps the client predicted and every acknowledgement falls on a move
+* boundary. The buffer aims to hold a little more input than the arrival jitter so it rarely runs dry.
+*
+* Underrun: the kart waits for the client's next moves rather than guessing at input it would have to take back.
+* Overrun: when far more than the target is buffered the excess is drained in the same tick, in at most MaxSteps moves.
+*
+*/
+class NETWORKRACERS_API FGoKartInputBuffer
+{
+public:
+	FGoKartInputBuffer();
+
+	// Buffer a move received from the client. ArrivalTime in seconds on the session clock.
+	void AddMove(const FGoKartMove& Move, double ArrivalTime);
+
+	/**
+	* Consume DeltaTime of buffered input, calling Simulate for each whole move it covers.
+	* Moves due this tick are always simulated; draining an overrun stops at MaxSteps. Returns the number of moves simulated.
+	*
+	*/
+	int32 Consume(float DeltaTime, int32 MaxSteps, TFunctionRef<void(const FGoKartMove&)> Simulate);
+
+	// Last move that was completely simulated, which is the one to acknowledge. MoveId is 0 until there is one.
+	const FGoKartMove& GetLastConsumedMove() const { return LastConsumedMove; };
+
+	// Input buffered but not yet simulated (s).
+	float GetBufferedTime() const { return BufferedTime; };
+
+	// How much input the buffer is currently trying to hold (s).
+	float GetTargetBufferTime() const { return TargetBufferTime; };
+
+	int32 Num() const { return Moves.Num(); };
+
+	void Reset();
+
+private:
+	TArray<FGoKartMove> Moves;
+	float BufferedTime;
+
+	// Nothing is consumed until the target has been buffered once.
+	bool bPrimed;
+
+	FGoKartMove LastConsumedMove;
+
+	// Server time not yet spent on moves, because the next one is longer than what is left (s).
+	float Budget;
+
+	double LastArrivalTime;
+
+	// Smoothed difference between the time between arrivals and the time the moves cover (s).
+	float ArrivalJitter;
+
+	float TargetBufferTime;
+
+};
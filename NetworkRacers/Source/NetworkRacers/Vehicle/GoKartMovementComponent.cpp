@@ -1,10 +1,15 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 #include "GoKartMovementComponent.h"
-#include "GameFramework/GameStateBase.h"
 #include "Engine/World.h"
 
 
+namespace GoKartMovement
+{
+	// Most steps an autonomous proxy catches up on in one frame. Time beyond that, eg. after a hitch, is dropped.
+	const int32 MaxStepsPerFrame = 8;
+}
+
 UGoKartMovementComponent::UGoKartMovementComponent()
 {
 	PrimaryComponentTick.bCanEverTick = true;
@@ -15,6 +20,26 @@ void UGoKartMovementComponent::BeginPlay()
 {
 	Super::BeginPlay();
 
+	UpdateKernel();
+
+}
+
+#if WITH_EDITOR
+void UGoKartMovementComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// Pick up handling tweaked while playing in the editor.
+	UpdateKernel();
+
+}
+#endif // WITH_EDITOR
+
+void UGoKartMovementComponent::UpdateKernel()
+{
+	Kernel = GoKartSimulation::GetKernel(VehicleClass);
+	KernelTuning = GetTuning();
+
 }
 
 void UGoKartMovementComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
@@ -22,16 +47,27 @@ void UGoKartMovementComponent::TickComponent(float DeltaTime, ELevelTick TickTyp
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
 	// If the player is an autonomous or simulated proxy, then create and simulate a move.
-	if (GetOwnerRole() == ROLE_AutonomousProxy || GetOwner()->GetRemoteRole() == ROLE_SimulatedProxy)
+	if (GetOwnerRole() == ROLE_AutonomousProxy)
+	{
+		StepAtNetworkRate(DeltaTime);
+
+	}
+	else if (GetOwner()->GetRemoteRole() == ROLE_SimulatedProxy)
 	{
-		// Track previous move for comparisons.
-		PrevMove = CreateMove(DeltaTime);
-		SimulateMove(PrevMove);
+		SimulateLocalMove(DeltaTime);
 
 	}
 
 }
 
+void UGoKartMovementComponent::SimulateLocalMove(float DeltaTime)
+{
+	// Track previous move for comparisons.
+	PrevMove = CreateMove(DeltaTime);
+	SimulateMove(PrevMove);
+
+}
+
 FGoKartMove UGoKartMovementComponent::CreateMove(float DeltaTime)
 {
 	FGoKartMove Move;
@@ -39,105 +75,183 @@ FGoKartMove UGoKartMovementComponent::CreateMove(float DeltaTime)
 	Move.SteeringThrow = SteeringThrow;
 	Move.Throttle = Throttle;
 
-	AGameStateBase* GameStateBase = GetWorld()->GetGameState();
-	Move.TimeStamp = GameStateBase->GetServerWorldTimeSeconds(); // Get the server time
+	// The replicator stamps moves with its synchronized server clock when it sends them.
+	Move.TimeStamp = 0;
 
 	return Move;
 
 }
 
+void UGoKartMovementComponent::StepAtNetworkRate(float DeltaTime)
+{
+	/**
+	* Only the autonomous proxy sends its moves over the network, so only it steps at a fixed rate: frame time is banked
+	* and one step of 1 / NetworkStepRate is simulated for each whole interval, with the input of the frame it falls in.
+	* The server simulates exactly these steps, so its cost doesn't depend on the client's frame rate, and steps with
+	* unchanged input are identical, so the replicator can merge them into one move.
+	*
+	*/
+	const float StepTime = 1.f / FMath::Max(NetworkStepRate, 1.f);
+	TimeSinceStep += DeltaTime;
+	const int32 NumSteps = FMath::Min(FMath::FloorToInt(TimeSinceStep / StepTime), GoKartMovement::MaxStepsPerFrame);
+	TimeSinceStep = NumSteps < GoKartMovement::MaxStepsPerFrame ? TimeSinceStep - NumSteps * StepTime : 0.f;
+
+	// Track previous move for comparisons. A frame too short for a step leaves a move of no steps.
+	PrevMove = CreateMove(StepTime);
+	PrevMove.Steps = NumSteps;
+
+	FGoKartMove Step = PrevMove;
+	Step.Steps = 1;
+	for (int32 StepIndex = 0; StepIndex < NumSteps; ++StepIndex)
+	{
+		SimulateMove(Step);
+
+	}
+
+}
+
 void UGoKartMovementComponent::SimulateMove(const FGoKartMove& Move)
 {
-	FVector Force = GetOwner()->GetActorForwardVector() * MaxDrivingForce * Move.Throttle;
+	const bool bHasInput = Move.Throttle != 0.f || Move.SteeringThrow != 0.f;
+	if (bAsleep)
+	{
+		if (!bHasInput) return;
+		WakeUp();
+
+	}
+
+	FGoKartSimState State;
+	State.Location = GetOwner()->GetActorLocation();
+	State.Rotation = GetOwner()->GetActorQuat();
+	State.Velocity = Velocity;
+
+	// The kernel is chosen once for the vehicle class, not per move.
+	if (Kernel == nullptr) UpdateKernel();
+	Kernel(State, Move, KernelTuning, GetWorld()->GetGravityZ());
+
+	Velocity = State.Velocity;
+	GetOwner()->SetActorRotation(State.Rotation);
+
+	// The simulation doesn't know about the world, so sweep to where it says the kart got to.
+	FHitResult Hit;
+	GetOwner()->AddActorWorldOffset(State.Location - GetOwner()->GetActorLocation(), true, &Hit);
+	if (Hit.IsValidBlockingHit())
+	{
+		UGoKartMovementComponent* Other = Hit.GetActor() != nullptr ? Hit.GetActor()->FindComponentByClass<UGoKartMovementComponent>() : nullptr;
+		if (Other != nullptr && Other != this)
+		{
+			ResolveContact(*Other, Hit);
+
+		}
+		else
+		{
+			Velocity = FVector::ZeroVector;
 
-	Force += GetAirResistance();
-	Force += GetRollingResistance();
+		}
 
-	FVector Acceleration = Force / Mass;
+	}
+
+	// Resistance never quite brings the kart to a stop, so settle it once it has been crawling for a while.
+	if (!bHasInput && Velocity.SizeSquared() < FMath::Square(SleepSpeed))
+	{
+		TimeAtRest += Move.DeltaTime;
+		if (TimeAtRest >= SleepDelay)
+		{
+			Velocity = FVector::ZeroVector;
+			bAsleep = true;
 
-	Velocity = Velocity + Acceleration * Move.DeltaTime;
+		}
 
-	ApplyRotation(Move.DeltaTime, Move.SteeringThrow);
+	}
+	else
+	{
+		TimeAtRest = 0.f;
 
-	UpdateLocationFromVelocity(Move.DeltaTime);
+	}
 
 }
 
-FVector UGoKartMovementComponent::GetAirResistance()
+void UGoKartMovementComponent::ReplayMove(const FGoKartMove& Move)
 {
-	/**
-	* GetSafeNormal() is the direction of the vector that the GoKart is travelling.
-	* SizeSquared() is the speed of the vector, squared.
-	*
-	* -(Direction * Speed^2 * Drag)
-	*
-	*/
-	return -(Velocity.GetSafeNormal() * Velocity.SizeSquared() * DragCoefficient);
+	bReplaying = true;
+	SimulateMove(Move);
+	bReplaying = false;
 
 }
 
-FVector UGoKartMovementComponent::GetRollingResistance()
+void UGoKartMovementComponent::ResolveContact(UGoKartMovementComponent& Other, const FHitResult& Hit)
 {
-	/**
-	* GetGravityZ() gets the force of gravity in the Z axis.
-	* Unreal gets the value in relation to cm, and automatically applies a (-) sign to denote a downward force on the Z axis.
-	* ...therefore
-	* We divide by 100 to get the value in relation to m, and apply another (-) sign to make the value positive so we can use it.
-	*
-	* NormalForce is the force applied to counteract gravity. nF = M * G (NormalForce = Mass * Acceleration of gravity)
-	*
-	*/
-	float AccelerationDueToGravity = -(GetWorld()->GetGravityZ()) / 100;
-	float NormalForce = Mass * AccelerationDueToGravity;
-	return -(Velocity.GetSafeNormal() * RollingResistanceCoefficient * NormalForce);
+	// Karts stay on the ground, so they only push each other sideways.
+	const FVector Normal = FVector(Hit.ImpactNormal.X, Hit.ImpactNormal.Y, 0.f).GetSafeNormal();
+	const float ClosingSpeed = -FVector::DotProduct(Velocity - Other.Velocity, Normal);
+	if (Normal.IsZero() || ClosingSpeed <= 0.f) return;
+
+	// Impulse (kg m/s) along the contact normal.
+	const float InverseMass = 1.f / FMath::Max(Mass, 1.f);
+	const float OtherInverseMass = 1.f / FMath::Max(Other.Mass, 1.f);
+	const float Impulse = (1.f + ContactRestitution) * ClosingSpeed / (InverseMass + OtherInverseMass);
+
+	Velocity += Normal * Impulse * InverseMass;
+	if (!bReplaying)
+	{
+		Other.SetVelocity(Other.Velocity - Normal * Impulse * OtherInverseMass);
+
+	}
 
 }
 
-void UGoKartMovementComponent::ApplyRotation(float DeltaTime, float SteeringThrow)
+void UGoKartMovementComponent::SetVelocity(FVector Val)
 {
-	/**
-	* Calculate Steering Turning
-	* dx = dTheta * r
-	* Change in location along the turning circle in 1 second (dx).
-	* Angle calculated from dx in relation to the turning circle (dTheta).
-	* Radius of the turning circle (r).
-	*
-	* DotProduct(A, B) returns a float that represents an angular relationship between A and B.
-	* This relationship projects the length of vector B in the direction of vector A.
-	*
-	* dx is DeltaLocation
-	* r is MinTurningRadius
-	* dTheta is RotationAngle
-	*
-	*/
-	float DeltaLocation = FVector::DotProduct(GetOwner()->GetActorForwardVector(), Velocity) * DeltaTime;
-	float RotationAngle = (DeltaLocation / MinTurningRadius) * SteeringThrow;
-	FQuat RotationDelta(GetOwner()->GetActorUpVector(), RotationAngle);
+	Velocity = Val;
 
-	Velocity = RotationDelta.RotateVector(Velocity);
+	// Being pushed, eg. by a correction from the server, wakes the kart.
+	if (Velocity.SizeSquared() >= FMath::Square(SleepSpeed))
+	{
+		WakeUp();
 
-	GetOwner()->AddActorWorldRotation(RotationDelta);
+	}
 
 }
 
-void UGoKartMovementComponent::UpdateLocationFromVelocity(float DeltaTime)
+void UGoKartMovementComponent::ResetMovement()
 {
-	/**
-	 * dx = v * dt
-	 * Change in location = Velocity * Change in time
-	 *
-	 * Our Velocity is calculated in meters per second (m/s).
-	 * We multiply by 100 because AddActorWorldOffset expects the Translation to be in centimeters.
-	 *
-	 */
-	FVector Translation = Velocity * 100 * DeltaTime;
+	Velocity = FVector::ZeroVector;
+	Throttle = 0.f;
+	SteeringThrow = 0.f;
+	TimeSinceStep = 0.f;
 
-	FHitResult Hit;
-	GetOwner()->AddActorWorldOffset(Translation, true, &Hit);
-	if (Hit.IsValidBlockingHit())
-	{
-		Velocity = FVector::ZeroVector;
+	PrevMove = FGoKartMove();
+	PrevMove.Throttle = 0.f;
+	PrevMove.SteeringThrow = 0.f;
+	PrevMove.DeltaTime = 0.f;
 
-	}
+	WakeUp();
+
+}
+
+void UGoKartMovementComponent::GoToSleep()
+{
+	Velocity = FVector::ZeroVector;
+	bAsleep = true;
+
+}
+
+void UGoKartMovementComponent::WakeUp()
+{
+	bAsleep = false;
+	TimeAtRest = 0.f;
+
+}
+
+FGoKartTuning UGoKartMovementComponent::GetTuning() const
+{
+	FGoKartTuning Tuning;
+	Tuning.Mass = Mass;
+	Tuning.MaxDrivingForce = MaxDrivingForce;
+	Tuning.MinTurningRadius = MinTurningRadius;
+	Tuning.DragCoefficient = DragCoefficient;
+	Tuning.RollingResistanceCoefficient = RollingResistanceCoefficient;
+
+	return Tuning;
 
 }
@@ -4,32 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "GoKartMovementInterface.h"
+#include "GoKartSimulation.h"
 #include "GoKartMovementComponent.generated.h"
 
 
-USTRUCT()
-struct FGoKartMove
-{
-	GENERATED_USTRUCT_BODY()
-
-	UPROPERTY()
-	float Throttle;
-
-	UPROPERTY()
-	float SteeringThrow;
-
-	UPROPERTY()
-	float DeltaTime;
-
-	UPROPERTY()
-	float TimeStamp;
-
-	bool IsValid() const { return FMath::Abs(Throttle) <= 1 && FMath::Abs(SteeringThrow) <= 1 && DeltaTime >= 0.f; };
-
-};
-
 UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
-class NETWORKRACERS_API UGoKartMovementComponent : public UActorComponent
+class NETWORKRACERS_API UGoKartMovementComponent : public UActorComponent, public IGoKartMovementInterface
 {
 	GENERATED_BODY()
 
@@ -38,30 +19,53 @@ public:
 
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
-	void SimulateMove(const FGoKartMove& Move);
+	// Begin IGoKartMovementInterface
+	virtual void SimulateMove(const FGoKartMove& Move) override;
 
+	virtual void ReplayMove(const FGoKartMove& Move) override;
 
-	FGoKartMove GetPrevMove() { return PrevMove; };
+	virtual FGoKartMove GetPrevMove() const override { return PrevMove; };
 
-	FVector GetVelocity() { return Velocity; };
-	void SetVelocity(FVector Val) { Velocity = Val; };
+	virtual FVector GetVelocity() const override { return Velocity; };
+	virtual void SetVelocity(FVector Val) override;
+
+	virtual bool IsAsleep() const override { return bAsleep; };
+	virtual void GoToSleep() override;
+
+	virtual void ResetMovement() override;
+	// End IGoKartMovementInterface
+
+	void WakeUp();
+
+	// Build a move from the current throttle and steering and simulate it, as TickComponent does for karts the server drives.
+	void SimulateLocalMove(float DeltaTime);
 
 	void SetThrottle(float Val) { Throttle = Val; };
 	void SetSteeringThrow(float Val) { SteeringThrow = Val; };
 
+	// Handling parameters as the stateless simulation takes them, see GoKartSimulation.
+	FGoKartTuning GetTuning() const;
+
+	EGoKartVehicleClass GetVehicleClass() const { return VehicleClass; };
+
 protected:
 	virtual void BeginPlay() override;
 
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif // WITH_EDITOR
+
 private:
 	FGoKartMove CreateMove(float DeltaTime);
 
-	FVector GetAirResistance();
-
-	FVector GetRollingResistance();
+	// Simulate the fixed steps an autonomous proxy sends to the server for this frame, see NetworkStepRate.
+	void StepAtNetworkRate(float DeltaTime);
 
-	void ApplyRotation(float DeltaTime, float SteeringThrow);
+	// Look up the kernel for VehicleClass and snapshot the tuning it is run with.
+	void UpdateKernel();
 
-	void UpdateLocationFromVelocity(float DeltaTime);
+	// Bounce off another kart we have run into, pushing it as well unless we are only replaying.
+	void ResolveContact(UGoKartMovementComponent& Other, const FHitResult& Hit);
 
 	// Mass of GoKart (kg)
 	UPROPERTY(EditAnywhere)
@@ -95,12 +99,57 @@ private:
 	UPROPERTY(EditAnywhere)
 	float RollingResistanceCoefficient = 0.015;
 
+	/**
+	* A kart with no input that has slowed to below SleepSpeed (m/s) for SleepDelay (s) goes to sleep: moves without
+	* input are skipped, with no simulation or sweep, until it gets input or is given a velocity.
+	* Karts waiting on the grid or parked after the finish cost next to nothing this way.
+	*
+	*/
+	UPROPERTY(EditAnywhere)
+	float SleepSpeed = 0.05f;
+
+	UPROPERTY(EditAnywhere)
+	float SleepDelay = 0.5f;
+
+	/**
+	* How much of their closing speed two karts that run into each other bounce apart with, 0 to 1.
+	* Contacts are resolved wherever karts are simulated: on the server, and on clients against nearby karts they
+	* predict (see UGoKartMovementReplicator::PredictionRadius), so bumps are predicted rather than corrected.
+	*
+	*/
+	UPROPERTY(EditAnywhere)
+	float ContactRestitution = 0.3f;
+
+	// While replaying, the karts we hit are already where the replayed contact left them.
+	bool bReplaying = false;
+
+	bool bAsleep = false;
+	float TimeAtRest = 0.f;
+
+	// Modelling choices, each compiled into its own simulation kernel. See EGoKartVehicleClass.
+	UPROPERTY(EditAnywhere)
+	EGoKartVehicleClass VehicleClass = EGoKartVehicleClass::Standard;
+
+	GoKartSimulation::FKernel Kernel = nullptr;
+	FGoKartTuning KernelTuning;
+
 	FVector Velocity;
 
+	/**
+	* Rate at which an autonomous proxy steps its simulation (Hz). Each step is one move, so this is also the rate
+	* moves are simulated at on the server, whatever the client's frame rate.
+	*
+	*/
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "1.0"))
+	float NetworkStepRate = 60.f;
+
 	float Throttle;
 
 	float SteeringThrow;
 
+	// Frame time not yet covered by a step at NetworkStepRate (s).
+	float TimeSinceStep = 0.f;
+
 	FGoKartMove PrevMove;
 	
 };
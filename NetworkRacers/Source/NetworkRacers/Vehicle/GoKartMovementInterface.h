@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Interface.h"
+#include "GoKartMovementInterface.generated.h"
+
+
+USTRUCT()
+struct FGoKartMove
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY()
+	float Throttle;
+
+	UPROPERTY()
+	float SteeringThrow;
+
+	UPROPERTY()
+	bool bHandbrake = false;
+
+	// Length of each step (s).
+	UPROPERTY()
+	float DeltaTime;
+
+	// Identical steps the move stands for, so a merged run is simulated step by step exactly as it was predicted.
+	UPROPERTY()
+	uint8 Steps = 1;
+
+	// Sequence number assigned when the move is sent, used to acknowledge it. 0 means not sent. Wraps around.
+	UPROPERTY()
+	uint32 MoveId = 0;
+
+	// When the move was made, in ticks of the server's session clock (see GoKartTime).
+	UPROPERTY()
+	int64 TimeStamp = 0;
+
+	// On the server, when the move arrived, in ticks of its session clock. Not replicated.
+	int64 ReceiveTicks = 0;
+
+	// Whether move A was sent after move B, allowing for MoveId wrapping around.
+	static bool IsNewer(uint32 MoveIdA, uint32 MoveIdB) { return static_cast<int32>(MoveIdA - MoveIdB) > 0; };
+
+	bool IsValid() const { return FMath::Abs(Throttle) <= 1 && FMath::Abs(SteeringThrow) <= 1 && DeltaTime >= 0.f && Steps >= 1; };
+
+	// Time the whole move covers (s).
+	float GetDuration() const { return DeltaTime * Steps; };
+
+	// Moves with identical input and step length can be merged into one move of more steps without changing what is simulated.
+	bool CanCombineWith(const FGoKartMove& Other) const
+	{
+		return Throttle == Other.Throttle && SteeringThrow == Other.SteeringThrow && bHandbrake == Other.bHandbrake
+			&& DeltaTime == Other.DeltaTime && Steps + Other.Steps <= MAX_uint8;
+	};
+	void Combine(const FGoKartMove& Other) { Steps += Other.Steps; MoveId = Other.MoveId; TimeStamp = Other.TimeStamp; };
+
+};
+
+UINTERFACE(MinimalAPI, meta = (CannotImplementInterfaceInBlueprint))
+class UGoKartMovementInterface : public UInterface
+{
+	GENERATED_BODY()
+
+};
+
+/**
+* Movement that UGoKartMovementReplicator can predict, acknowledge and reconcile.
+*
+* The implementing component builds a move from local input every tick, simulates moves it is given,
+* and exposes the velocity (m/s) that is replicated alongside the actor's transform.
+*
+*/
+class NETWORKRACERS_API IGoKartMovementInterface
+{
+	GENERATED_BODY()
+
+public:
+	// Move built from local input and simulated during the last tick.
+	virtual FGoKartMove GetPrevMove() const = 0;
+
+	// Simulate a single step of a move. On the server this is how moves received from the owning client are applied.
+	virtual void SimulateMove(const FGoKartMove& Move) = 0;
+
+	// Re-simulate a move the server hasn't acknowledged yet, after the client has snapped back to server state.
+	virtual void ReplayMove(const FGoKartMove& Move) { SimulateMove(Move); };
+
+	virtual FVector GetVelocity() const = 0;
+	virtual void SetVelocity(FVector Val) = 0;
+
+	/**
+	* Whether SimulateMove only schedules the move, for the physics scene to apply during its substeps. The replicator
+	* then acknowledges moves after physics has run, once GetCompletedMoveId reports them, rather than straight away.
+	*
+	*/
+	virtual bool SimulatesDuringPhysics() const { return false; };
+
+	// For movement that simulates during physics, the newest move physics has finished, and how far physics has got into the moves after it (s).
+	virtual uint32 GetCompletedMoveId(float& OutTimeIntoNextMove) const { OutTimeIntoNextMove = 0.f; return 0; };
+
+	// Whether the kart is at rest and skipping simulation until it gets input or is pushed.
+	virtual bool IsAsleep() const { return false; };
+
+	// Put the kart to sleep straight away, eg. on the owning client when the server says it is asleep.
+	virtual void GoToSleep() {};
+
+	// Forget everything carried over from earlier moves: velocity, input and sleep. Eg. when a pooled pawn is reused.
+	virtual void ResetMovement() = 0;
+
+};
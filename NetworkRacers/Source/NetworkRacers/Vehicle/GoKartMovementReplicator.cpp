@@ -4,13 +4,96 @@
 #include "UnrealNetwork.h"
 #include "GameFramework/Actor.h"
 #include "Engine/World.h"
-#include "GameFramework/GameStateBase.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerState.h"
+#include "GameFramework/PlayerController.h"
+#include "NetworkRacersGameMode.h"
+#include "GoKartSnapshotStream.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Stats/Stats.h"
+
+DECLARE_STATS_GROUP(TEXT("KartLatency"), STATGROUP_KartLatency, STATCAT_Advanced);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Input to server (ms)"), STAT_KartInputToServer, STATGROUP_KartLatency);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Server queue (ms)"), STAT_KartServerQueue, STATGROUP_KartLatency);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Input to ack (ms)"), STAT_KartInputToAck, STATGROUP_KartLatency);
+
+namespace GoKartLatency
+{
+	void PrintKartLatency(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+	{
+		if (World == nullptr) return;
+
+		for (FConstPlayerControllerIterator It = World->GetPlayerControllerIterator(); It; ++It)
+		{
+			const APawn* Pawn = It->IsValid() ? (*It)->GetPawn() : nullptr;
+			const UGoKartMovementReplicator* Replicator = Pawn != nullptr ? Pawn->FindComponentByClass<UGoKartMovementReplicator>() : nullptr;
+			if (Replicator == nullptr || Pawn->Role != ROLE_AutonomousProxy) continue;
+
+			const FGoKartMoveLatency& Last = Replicator->GetLastMoveLatency();
+			Ar.Logf(TEXT("%s: last move input to server %.1f ms, server queue %.1f ms, input to ack %.1f ms"), *Pawn->GetName(),
+				Last.InputToServer * 1000.f, Last.ServerQueue * 1000.f, Last.InputToAck * 1000.f);
+
+			const TCHAR* Names[] = { TEXT("Input to server"), TEXT("Server queue"), TEXT("Input to ack") };
+			const EGoKartNetStat Stats[] = { EGoKartNetStat::InputToServer, EGoKartNetStat::ServerQueueTime, EGoKartNetStat::InputToAck };
+			for (int32 Index = 0; Index < ARRAY_COUNT(Stats); ++Index)
+			{
+				const FGoKartHistogram& Histogram = Replicator->GetNetStats().Histograms[(int32)Stats[Index]];
+				Ar.Logf(TEXT("  %s over %llu moves: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, max %.1f ms"), Names[Index], Histogram.GetCount(),
+					Histogram.GetPercentile(50.f) / 1000.f, Histogram.GetPercentile(90.f) / 1000.f, Histogram.GetPercentile(99.f) / 1000.f, Histogram.GetMax() / 1000.f);
+
+			}
+
+		}
+
+	}
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice KartLatencyCommand(
+	TEXT("NetRacers.KartLatency"),
+	TEXT("Print the latency of the local karts' moves: input to server, server queue and input to ack, for the last move and over the session."),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&GoKartLatency::PrintKartLatency));
+
+#if ENABLE_KART_NET_DEBUG
+#include "Debug/DebugDrawService.h"
+#include "Engine/Canvas.h"
+#include "Engine/Engine.h"
+#include "CanvasItem.h"
 
+static TAutoConsoleVariable<int32> CVarKartNetDebug(
+	TEXT("NetRacers.KartNetDebug"),
+	0,
+	TEXT("Show the kart net-debug overlay: role, pending moves, last correction, replication rate, RTT and correction history.\n")
+	TEXT(" 0: off (default)\n")
+	TEXT(" 1: on"),
+	ECVF_Cheat);
+#endif // ENABLE_KART_NET_DEBUG
+
+
+void FGoKartReplicatorPostPhysicsTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target != nullptr && !Target->IsPendingKill())
+	{
+		Target->PostPhysicsTick();
+
+	}
+
+}
+
+FString FGoKartReplicatorPostPhysicsTickFunction::DiagnosticMessage()
+{
+	return Target != nullptr ? Target->GetFullName() + TEXT("[PostPhysicsTick]") : TEXT("<NULL>[PostPhysicsTick]");
+
+}
 
 UGoKartMovementReplicator::UGoKartMovementReplicator()
 {
 	PrimaryComponentTick.bCanEverTick = true;
 
+	PostPhysicsTickFunction.bCanEverTick = true;
+	PostPhysicsTickFunction.bStartWithTickEnabled = true;
+	PostPhysicsTickFunction.TickGroup = TG_PostPhysics;
+
 	SetIsReplicated(true);
 
 }
@@ -19,10 +102,60 @@ void UGoKartMovementReplicator::BeginPlay()
 {
 	Super::BeginPlay();
 
-	MovementComponent = GetOwner()->FindComponentByClass<UGoKartMovementComponent>();
+	// Any movement implementing IGoKartMovementInterface can be replicated, eg. the go-kart or the PhysX vehicle.
+	TArray<UActorComponent*> MovementComponents = GetOwner()->GetComponentsByInterface(UGoKartMovementInterface::StaticClass());
+	if (MovementComponents.Num() > 0)
+	{
+		MovementComponentObject = MovementComponents[0];
+		MovementComponent = Cast<IGoKartMovementInterface>(MovementComponentObject);
+
+		// We read the move the movement component built this frame, so it has to tick first.
+		PrimaryComponentTick.AddPrerequisite(MovementComponentObject, MovementComponentObject->PrimaryComponentTick);
+
+	}
+
+	SendRate.Configure(MinSendRate, MaxSendRate, MaxRedundancy);
+
+#if ENABLE_KART_NET_DEBUG
+	NetDebugDrawHandle = UDebugDrawService::Register(TEXT("Game"), FDebugDrawDelegate::CreateUObject(this, &UGoKartMovementReplicator::DrawNetDebug));
+#endif // ENABLE_KART_NET_DEBUG
 	
 }
 
+void UGoKartMovementReplicator::RegisterComponentTickFunctions(bool bRegister)
+{
+	Super::RegisterComponentTickFunctions(bRegister);
+
+	if (bRegister)
+	{
+		if (SetupActorComponentTickFunction(&PostPhysicsTickFunction))
+		{
+			PostPhysicsTickFunction.Target = this;
+
+		}
+
+	}
+	else if (PostPhysicsTickFunction.IsTickFunctionRegistered())
+	{
+		PostPhysicsTickFunction.UnRegisterTickFunction();
+
+	}
+
+}
+
+void UGoKartMovementReplicator::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	SetRaceInstanceId(INDEX_NONE);
+	SubmitNetStats();
+
+#if ENABLE_KART_NET_DEBUG
+	UDebugDrawService::Unregister(NetDebugDrawHandle);
+#endif // ENABLE_KART_NET_DEBUG
+
+	Super::EndPlay(EndPlayReason);
+
+}
+
 void UGoKartMovementReplicator::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
@@ -33,19 +166,40 @@ void UGoKartMovementReplicator::TickComponent(float DeltaTime, ELevelTick TickTy
 	// If we are a client.
 	if (GetOwnerRole() == ROLE_AutonomousProxy)
 	{
-		UnacknowledgedMoves.Add(PrevMove);
+		ClientClockSyncTick(DeltaTime);
 
-		Server_SendMove(PrevMove);
+		// Stamp the move with our estimate of the server's clock. Frames too short for a step made no move.
+		if (PrevMove.Steps > 0)
+		{
+			PrevMove.TimeStamp = GetSynchronizedServerTicks();
+			QueueMove(PrevMove);
+
+		}
+		SendMoves();
 
 	}
 
-	// If we are the server and controlling the pawn.
-	if (GetOwner()->GetRemoteRole() == ROLE_SimulatedProxy)
+	// If we are the server and controlling the pawn. Movement simulated during physics is published after it, see PostPhysicsTick.
+	if (GetOwner()->GetRemoteRole() == ROLE_SimulatedProxy && !MovementComponent->SimulatesDuringPhysics())
 	{
 		UpdateServerState(PrevMove);
 
 	}
 
+	// If we are the server and a client is controlling the pawn.
+	if (GetOwnerRole() == ROLE_Authority && GetOwner()->GetRemoteRole() == ROLE_AutonomousProxy)
+	{
+		ServerTick(DeltaTime);
+
+	}
+
+	// If we are the server, stop updating clients about a kart that has gone to sleep.
+	if (GetOwnerRole() == ROLE_Authority)
+	{
+		UpdateNetSleep();
+
+	}
+
 	// If we are being observed by other clients.
 	if (GetOwnerRole() == ROLE_SimulatedProxy)
 	{
@@ -55,12 +209,430 @@ void UGoKartMovementReplicator::TickComponent(float DeltaTime, ELevelTick TickTy
 
 }
 
-void UGoKartMovementReplicator::UpdateServerState(const FGoKartMove& Move)
+void UGoKartMovementReplicator::UpdateServerDrivenState()
 {
-	// Update player's move, location, and speed.
-	ServerState.PrevMove = Move;
-	ServerState.Transform = GetOwner()->GetActorTransform();
-	ServerState.Velocity = MovementComponent->GetVelocity();
+	if (MovementComponent == nullptr || GetOwnerRole() != ROLE_Authority) return;
+
+	if (!MovementComponent->SimulatesDuringPhysics())
+	{
+		UpdateServerState(MovementComponent->GetPrevMove());
+
+	}
+	UpdateNetSleep();
+
+}
+
+void UGoKartMovementReplicator::SetComponentTickEnabled(bool bEnabled)
+{
+	Super::SetComponentTickEnabled(bEnabled);
+
+	PostPhysicsTickFunction.SetTickFunctionEnable(bEnabled);
+
+}
+
+void UGoKartMovementReplicator::SubmitNetStats()
+{
+	const FString KartName = FString::Printf(TEXT("%s (%s)"), *GetOwner()->GetName(), GetOwnerRole() == ROLE_Authority ? TEXT("Server") : TEXT("Client"));
+	FGoKartNetStatsCollector::Get().SubmitKart(GetWorld(), KartName, NetStats);
+	NetStats = FGoKartNetStats();
+
+}
+
+void UGoKartMovementReplicator::ClientClockSyncTick(float DeltaTime)
+{
+	ClockSync.Tick(DeltaTime);
+
+	const double LocalTime = GoKartTime::TicksToSeconds(GoKartTime::GetSessionTicks());
+	if (ClockSync.WantsSample(LocalTime))
+	{
+		ClockSync.NoteSampleSent(LocalTime);
+		Server_RequestClockSync(GoKartTime::SecondsToTicks(LocalTime));
+
+	}
+
+}
+
+int64 UGoKartMovementReplicator::GetSynchronizedServerTicks() const
+{
+	if (!ClockSync.HasEstimate()) return 0;
+
+	const double LocalTime = GoKartTime::TicksToSeconds(GoKartTime::GetSessionTicks());
+	return GoKartTime::SecondsToTicks(ClockSync.GetServerTime(LocalTime));
+
+}
+
+void UGoKartMovementReplicator::Server_RequestClockSync_Implementation(int64 ClientSendTicks)
+{
+	Client_ReceiveClockSync(ClientSendTicks, GoKartTime::GetSessionTicks());
+
+}
+
+bool UGoKartMovementReplicator::Server_RequestClockSync_Validate(int64 ClientSendTicks)
+{
+	return true;
+
+}
+
+void UGoKartMovementReplicator::Client_ReceiveClockSync_Implementation(int64 ClientSendTicks, int64 ServerTicks)
+{
+	const int64 ReceiveTicks = GoKartTime::GetSessionTicks();
+	ClockSync.AddSample(GoKartTime::TicksToSeconds(ClientSendTicks), GoKartTime::TicksToSeconds(ServerTicks), GoKartTime::TicksToSeconds(ReceiveTicks));
+
+	NetStats.Record(EGoKartNetStat::RoundTripTime, (uint32)FMath::Max<int64>(0, ReceiveTicks - ClientSendTicks));
+
+}
+
+void UGoKartMovementReplicator::QueueMove(const FGoKartMove& Move)
+{
+	/**
+	* Karts spend most of a race at full throttle with steady steering, so consecutive moves are often identical.
+	* Rather than sending one move per step, count identical steps into the pending move until the input or step
+	* length changes, it reaches MaxCoalescedMoveTime, or a packet goes out. This cuts the moves sent and buffered.
+	*
+	*/
+	if (bHasPendingMove && PendingMove.CanCombineWith(Move) && PendingMove.GetDuration() + Move.GetDuration() <= MaxCoalescedMoveTime)
+	{
+		PendingMove.Combine(Move);
+		return;
+
+	}
+
+	FlushPendingMove();
+
+	PendingMove = Move;
+	bHasPendingMove = true;
+
+}
+
+void UGoKartMovementReplicator::FlushPendingMove()
+{
+	if (!bHasPendingMove) return;
+
+	PendingMove.MoveId = NextMoveId++;
+	if (NextMoveId == 0) NextMoveId = 1;
+
+	NetStats.Record(EGoKartNetStat::PendingMoves, UnacknowledgedMoves.Num());
+	UnacknowledgedMoves.Add(PendingMove);
+	++NumUnsentMoves;
+
+	bHasPendingMove = false;
+
+}
+
+void UGoKartMovementReplicator::SendMoves()
+{
+	const int32 PacketSize = FMath::Max(1, MaxMovesPerPacket);
+	const double LocalTime = GoKartTime::TicksToSeconds(GoKartTime::GetSessionTicks());
+	const bool bSendDue = LocalTime - LastSendTime >= SendRate.GetSendInterval();
+
+	// Never hold a merged run back past a send.
+	if (bSendDue)
+	{
+		FlushPendingMove();
+
+	}
+	if (NumUnsentMoves == 0) return;
+
+	// Wait for the next send at the current rate, unless a whole packet's worth is already waiting.
+	if (!bSendDue && NumUnsentMoves < PacketSize) return;
+
+	// Oldest unsent moves first, led by as many of the moves already sent as redundancy and the packet allow.
+	const int32 NumToSend = FMath::Min(NumUnsentMoves, PacketSize);
+	const int32 FirstUnsent = UnacknowledgedMoves.Num() - NumUnsentMoves;
+	const int32 NumRedundant = FMath::Min3(SendRate.GetRedundancy(), FirstUnsent, PacketSize - NumToSend);
+
+	const TArray<FGoKartMove> Moves(UnacknowledgedMoves.GetData() + FirstUnsent - NumRedundant, NumRedundant + NumToSend);
+	Server_SendMoves(Moves, SendRate.NoteSent(LocalTime));
+
+	NumUnsentMoves -= NumToSend;
+	LastSendTime = LocalTime;
+
+}
+
+void UGoKartMovementReplicator::SimulateSteps(const FGoKartMove& Move)
+{
+	FGoKartMove Step = Move;
+	Step.Steps = 1;
+	for (int32 StepIndex = 0; StepIndex < Move.Steps; ++StepIndex)
+	{
+		MovementComponent->SimulateMove(Step);
+
+	}
+
+}
+
+void UGoKartMovementReplicator::ReplaySteps(const FGoKartMove& Move, float& SkipTime)
+{
+	FGoKartMove Step = Move;
+	Step.Steps = 1;
+	for (int32 StepIndex = 0; StepIndex < Move.Steps; ++StepIndex)
+	{
+		const float Skipped = FMath::Min(SkipTime, Move.DeltaTime);
+		SkipTime -= Skipped;
+		Step.DeltaTime = Move.DeltaTime - Skipped;
+		if (Step.DeltaTime > KINDA_SMALL_NUMBER)
+		{
+			MovementComponent->ReplayMove(Step);
+
+		}
+
+	}
+
+}
+
+void UGoKartMovementReplicator::UpdateServerState(const FGoKartMove& LastMove)
+{
+	// Update player's acknowledged move, location, and speed.
+	OwnerState.Location = GetOwner()->GetActorLocation();
+	OwnerState.Rotation = GetOwner()->GetActorQuat();
+	OwnerState.Velocity = MovementComponent->GetVelocity();
+	OwnerState.AckedMoveId = LastMove.MoveId;
+	OwnerState.LastPacketId = LastReceivedPacketId;
+	OwnerState.PacketsLost = PacketsLost;
+	OwnerState.bAsleep = MovementComponent->IsAsleep();
+
+	// Observers only interpolate between updates, so they get them at a lower rate.
+	const float Now = GetWorld()->GetTimeSeconds();
+	if (ObserverUpdateRate > 0.f && LastObserverUpdateTime >= 0.f && Now - LastObserverUpdateTime < 1.f / ObserverUpdateRate) return;
+	LastObserverUpdateTime = Now;
+
+	ObserverState.Location = OwnerState.Location;
+	ObserverState.Rotation = GetOwner()->GetActorRotation();
+	ObserverState.Velocity = OwnerState.Velocity;
+	ObserverState.Throttle = LastMove.Throttle;
+	ObserverState.SteeringThrow = LastMove.SteeringThrow;
+
+	FGoKartSnapshot* Snapshot = SnapshotGameMode.IsValid() ? SnapshotGameMode->GetKartSnapshot(RaceInstanceId) : nullptr;
+	if (Snapshot != nullptr)
+	{
+		Snapshot->UpdateKart(KartId, ObserverState);
+
+	}
+
+}
+
+void UGoKartMovementReplicator::UpdateNetSleep()
+{
+	const bool bAsleep = MovementComponent->IsAsleep();
+	if (bAsleep == bNetAsleep) return;
+	bNetAsleep = bAsleep;
+
+	AActor* Owner = GetOwner();
+	if (bAsleep)
+	{
+		// Observers should see the kart come to rest before updates stop.
+		// A sleeping kart has no input.
+		FGoKartMove RestMove;
+		RestMove.Throttle = 0.f;
+		RestMove.SteeringThrow = 0.f;
+		RestMove.DeltaTime = 0.f;
+		RestMove.MoveId = OwnerState.AckedMoveId;
+
+		LastObserverUpdateTime = -1.f;
+		UpdateServerState(RestMove);
+
+		// Dormancy closes the actor channel, and with it the RPCs a client's moves arrive by, so their karts stay awake.
+		bNetDormant = Owner->GetRemoteRole() != ROLE_AutonomousProxy;
+		if (bNetDormant)
+		{
+			Owner->SetNetDormancy(DORM_DormantAll);
+
+		}
+
+	}
+	else
+	{
+		WakeNet();
+
+	}
+
+}
+
+void UGoKartMovementReplicator::WakeNet()
+{
+	AActor* Owner = GetOwner();
+	if (bNetDormant)
+	{
+		Owner->SetNetDormancy(DORM_Awake);
+
+	}
+	Owner->ForceNetUpdate();
+
+	bNetAsleep = false;
+	bNetDormant = false;
+
+}
+
+void UGoKartMovementReplicator::ResetServerInput()
+{
+	// A pooled kart handed to a new driver starts awake as far as the network is concerned.
+	if (bNetAsleep)
+	{
+		WakeNet();
+
+	}
+
+	ServerInputBuffer.Reset();
+	InFlightMoves.Reset();
+	bClientSimulatedTimeStarted = false;
+	LastReceivedMoveId = 0;
+	bHasReceivedPacket = false;
+	PacketsLost = 0;
+
+	++ResetCount;
+
+}
+
+void UGoKartMovementReplicator::OnRep_ResetCount()
+{
+	ResetClientInput();
+
+}
+
+void UGoKartMovementReplicator::ResetClientInput()
+{
+	// The stats so far are the previous driver's.
+	SubmitNetStats();
+
+	UnacknowledgedMoves.Reset();
+	bHasPendingMove = false;
+	NumUnsentMoves = 0;
+	LastSendTime = -DBL_MAX;
+	LastMoveLatency = FGoKartMoveLatency();
+
+	SendRate = FGoKartSendRate();
+	SendRate.Configure(MinSendRate, MaxSendRate, MaxRedundancy);
+
+	if (MovementComponent != nullptr)
+	{
+		MovementComponent->ResetMovement();
+
+	}
+
+}
+
+void UGoKartMovementReplicator::SetRaceInstanceId(int32 InRaceInstanceId)
+{
+	if (GetOwnerRole() != ROLE_Authority) return;
+
+	// Pooled pawns can be spawned before the game mode has begun play, so look it up when first needed.
+	if (!SnapshotGameMode.IsValid())
+	{
+		SnapshotGameMode = GetWorld()->GetAuthGameMode<ANetworkRacersGameMode>();
+
+	}
+
+	// Each race has its own snapshot, so the record is given back to the race we're leaving.
+	if (SnapshotGameMode.IsValid())
+	{
+		if (FGoKartSnapshot* OldSnapshot = SnapshotGameMode->GetKartSnapshot(RaceInstanceId))
+		{
+			OldSnapshot->RemoveKart(KartId);
+
+		}
+		KartId = INDEX_NONE;
+
+		if (FGoKartSnapshot* NewSnapshot = SnapshotGameMode->GetKartSnapshot(InRaceInstanceId))
+		{
+			KartId = NewSnapshot->AddKart();
+
+			// ObserverState is from the pawn's previous life until the server next simulates it.
+			FGoKartObserverState State;
+			State.Location = GetOwner()->GetActorLocation();
+			State.Rotation = GetOwner()->GetActorRotation();
+			NewSnapshot->UpdateKart(KartId, State);
+
+		}
+
+	}
+
+	RaceInstanceId = InRaceInstanceId;
+
+}
+
+void UGoKartMovementReplicator::OnRep_KartId()
+{
+	// The kart's actor is here now, so joiners stop showing it from the snapshot.
+	for (TActorIterator<AGoKartSnapshotStream> It(GetWorld()); It; ++It)
+	{
+		It->OnKartArrived(KartId);
+
+	}
+
+}
+
+bool UGoKartMovementReplicator::IsAdmittedFor(const AActor* Viewer) const
+{
+	// A joining player's own kart is never held back.
+	if (!SnapshotGameMode.IsValid() || KartId == INDEX_NONE || GetOwner()->GetOwner() == Viewer) return true;
+
+	return SnapshotGameMode->IsKartAdmittedFor(KartId, RaceInstanceId, Viewer);
+
+}
+
+void UGoKartMovementReplicator::ServerTick(float DeltaTime)
+{
+	const uint64 StartCycles = FPlatformTime::Cycles64();
+
+	// Simulate a steady tick's worth of the client's buffered moves, however they arrived.
+	const bool bSimulatesDuringPhysics = MovementComponent->SimulatesDuringPhysics();
+	const int32 Steps = ServerInputBuffer.Consume(DeltaTime, FMath::Max(1, MaxMovesPerTick), [this, bSimulatesDuringPhysics](const FGoKartMove& Move)
+	{
+		SimulateSteps(Move);
+		if (bSimulatesDuringPhysics)
+		{
+			InFlightMoves.Add(Move);
+
+		}
+	});
+	if (Steps == 0) return;
+
+	NetStats.Record(EGoKartNetStat::ServerMoveTime, (uint32)(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) * 1000.0));
+
+	// Moves are only ever simulated whole, so this is exactly the state after the acknowledged move. The client replays anything after it.
+	if (!bSimulatesDuringPhysics)
+	{
+		OwnerState.AckedMoveReceiveTicks = ServerInputBuffer.GetLastConsumedMove().ReceiveTicks;
+		OwnerState.AckedMoveSimulateTicks = GoKartTime::GetSessionTicks();
+		OwnerState.TimeIntoNextMove = 0.f;
+		UpdateServerState(ServerInputBuffer.GetLastConsumedMove());
+
+	}
+
+}
+
+void UGoKartMovementReplicator::PostPhysicsTick()
+{
+	if (MovementComponent == nullptr || GetOwnerRole() != ROLE_Authority || !MovementComponent->SimulatesDuringPhysics()) return;
+
+	// Our own driver's input went in before physics, so the state after it is the one to publish.
+	if (GetOwner()->GetRemoteRole() == ROLE_SimulatedProxy)
+	{
+		UpdateServerState(MovementComponent->GetPrevMove());
+		return;
+
+	}
+
+	/**
+	* The moves ServerTick scheduled before physics have now been applied by its substeps, as far as it got. Acknowledge
+	* the newest one physics finished, and tell the client how far into the next one the state is, so it replays only the
+	* rest of that move.
+	*
+	*/
+	if (InFlightMoves.Num() == 0) return;
+
+	float TimeIntoNextMove = 0.f;
+	const uint32 CompletedMoveId = MovementComponent->GetCompletedMoveId(TimeIntoNextMove);
+	const int32 CompletedIndex = InFlightMoves.IndexOfByPredicate([CompletedMoveId](const FGoKartMove& Move) { return Move.MoveId == CompletedMoveId; });
+	if (CompletedIndex == INDEX_NONE) return;
+
+	const FGoKartMove AckedMove = InFlightMoves[CompletedIndex];
+	InFlightMoves.RemoveAt(0, CompletedIndex + 1, false);
+
+	OwnerState.AckedMoveReceiveTicks = AckedMove.ReceiveTicks;
+	OwnerState.AckedMoveSimulateTicks = GoKartTime::GetSessionTicks();
+	OwnerState.TimeIntoNextMove = TimeIntoNextMove;
+	UpdateServerState(AckedMove);
 
 }
 
@@ -68,8 +640,15 @@ void UGoKartMovementReplicator::ClientTick(float DeltaTime)
 {
 	ClientTimeSinceUpdate += DeltaTime;
 
-	if (ClientTimeBetweenLastUpdates < KINDA_SMALL_NUMBER) return;
 	if (MovementComponent == nullptr) return;
+	if (bPredicting)
+	{
+		PredictTick(DeltaTime);
+		return;
+
+	}
+
+	if (ClientTimeBetweenLastUpdates < KINDA_SMALL_NUMBER) return;
 
 	float LerpRatio = ClientTimeSinceUpdate / ClientTimeBetweenLastUpdates;
 
@@ -88,10 +667,10 @@ FHermiteCubicSpline UGoKartMovementReplicator::CreateSpline()
 {
 	// Update spline variables.
 	FHermiteCubicSpline Spline;
-	Spline.TargetLocation = ServerState.Transform.GetLocation();
+	Spline.TargetLocation = ObserverState.Location;
 	Spline.StartLocation = ClientStartTransform.GetLocation();
 	Spline.StartDerivative = ClientStartVelocity * VelocityToDerivative();
-	Spline.TargetDerivative = ServerState.Velocity * VelocityToDerivative();
+	Spline.TargetDerivative = ObserverState.Velocity * VelocityToDerivative();
 
 	return Spline;
 
@@ -120,7 +699,7 @@ void UGoKartMovementReplicator::InterpolateVelocity(const FHermiteCubicSpline &S
 
 void UGoKartMovementReplicator::InterpolateRotation(float LerpRatio)
 {
-	FQuat TargetRotation = ServerState.Transform.GetRotation();
+	FQuat TargetRotation = ObserverState.Rotation.Quaternion();
 	FQuat StartRotation = ClientStartTransform.GetRotation();
 
 	// Interpolate using Slerp for rotation so the bounds become -180 and 180 (spherical)
@@ -139,56 +718,161 @@ float UGoKartMovementReplicator::VelocityToDerivative()
 
 }
 
+float UGoKartMovementReplicator::GetPredictionTime() const
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	const APawn* LocalKart = PlayerController != nullptr ? PlayerController->GetPawn() : nullptr;
+	if (LocalKart == nullptr || LocalKart == GetOwner() || LocalKart->Role != ROLE_AutonomousProxy) return -1.f;
+
+	if (FVector::DistSquared(LocalKart->GetActorLocation(), ObserverState.Location) > FMath::Square(PredictionRadius)) return -1.f;
+
+	// No estimate before the local kart's first clock sync exchange.
+	const UGoKartMovementReplicator* LocalReplicator = LocalKart->FindComponentByClass<UGoKartMovementReplicator>();
+	if (LocalReplicator == nullptr || LocalReplicator->GetRoundTripTime() <= 0.f) return -1.f;
+
+	/**
+	* ObserverState left the server half a round trip ago, and the moves the local kart is making now reach the server
+	* half a round trip from now, so the local kart is a whole round trip ahead of it.
+	*
+	*/
+	return FMath::Min(LocalReplicator->GetRoundTripTime(), MaxPredictionTime);
+
+}
+
+void UGoKartMovementReplicator::SimulateObservedInput(float Time, bool bReplay)
+{
+	FGoKartMove Move;
+	Move.Throttle = ObserverState.Throttle;
+	Move.SteeringThrow = ObserverState.SteeringThrow;
+
+	const float Step = PredictionStep > 0.f ? PredictionStep : Time;
+	while (Time > 0.f)
+	{
+		Move.DeltaTime = FMath::Min(Time, Step);
+		if (bReplay)
+		{
+			MovementComponent->ReplayMove(Move);
+		}
+		else
+		{
+			MovementComponent->SimulateMove(Move);
+		}
+		Time -= Move.DeltaTime;
+
+	}
+
+}
+
+void UGoKartMovementReplicator::PredictTick(float DeltaTime)
+{
+	// Keep driving on the last input we were told about. Contacts with the local kart are resolved as they happen.
+	SimulateObservedInput(DeltaTime, false);
+
+	if (MeshOffsetRoot != nullptr)
+	{
+		const float Alpha = 1.f - FMath::Exp(-PredictionSmoothingSpeed * DeltaTime);
+		const FVector Location = FMath::Lerp(MeshOffsetRoot->GetComponentLocation(), GetOwner()->GetActorLocation(), Alpha);
+		const FQuat Rotation = FQuat::Slerp(MeshOffsetRoot->GetComponentQuat(), GetOwner()->GetActorQuat(), Alpha);
+		MeshOffsetRoot->SetWorldLocationAndRotation(Location, Rotation);
+
+	}
+
+}
+
 void UGoKartMovementReplicator::GetLifetimeReplicatedProps(TArray< FLifetimeProperty > & OutLifetimeProps) const
 {
 	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
 
 	// Variables to replicate on server.
-	DOREPLIFETIME(UGoKartMovementReplicator, ServerState);
+	DOREPLIFETIME_CONDITION(UGoKartMovementReplicator, OwnerState, COND_OwnerOnly);
+	DOREPLIFETIME_CONDITION(UGoKartMovementReplicator, ObserverState, COND_SkipOwner);
+	DOREPLIFETIME(UGoKartMovementReplicator, KartId);
+	DOREPLIFETIME(UGoKartMovementReplicator, ResetCount);
 
 }
 
-void UGoKartMovementReplicator::OnRep_ServerState()
+bool FGoKartObserverState::NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
 {
-	// When ServerState is replicated...
-	switch (GetOwnerRole())
+	bOutSuccess = SerializePackedVector<10, 24>(Location, Ar);
+	Rotation.SerializeCompressedShort(Ar);
+	bOutSuccess &= SerializePackedVector<100, 20>(Velocity, Ar);
+
+	// Input is within [-1, 1].
+	int8 QuantizedThrottle = static_cast<int8>(FMath::RoundToInt(FMath::Clamp(Throttle, -1.f, 1.f) * MAX_int8));
+	int8 QuantizedSteeringThrow = static_cast<int8>(FMath::RoundToInt(FMath::Clamp(SteeringThrow, -1.f, 1.f) * MAX_int8));
+	Ar << QuantizedThrottle << QuantizedSteeringThrow;
+	if (Ar.IsLoading())
 	{
-	case ROLE_AutonomousProxy:
-		AutonomousProxy_OnRep_ServerState();
-		break;
-	case ROLE_SimulatedProxy:
-		SimulatedProxy_OnRep_ServerState();
-		break;
-	default:
-		break;
+		Throttle = (float)QuantizedThrottle / MAX_int8;
+		SteeringThrow = (float)QuantizedSteeringThrow / MAX_int8;
+
 	}
 
+	return true;
+
 }
 
 // As client.
-void UGoKartMovementReplicator::AutonomousProxy_OnRep_ServerState()
+void UGoKartMovementReplicator::OnRep_OwnerState()
 {
-	if (MovementComponent == nullptr) return;
+	if (MovementComponent == nullptr || GetOwnerRole() != ROLE_AutonomousProxy) return;
+
+#if ENABLE_KART_NET_DEBUG
+	RecordServerStateReceived();
+#endif // ENABLE_KART_NET_DEBUG
+	const FVector PredictedLocation = GetOwner()->GetActorLocation();
 
-	GetOwner()->SetActorTransform(ServerState.Transform);
-	MovementComponent->SetVelocity(ServerState.Velocity);
+	// Teleport so a physics-simulated root keeps the velocity we set below.
+	GetOwner()->SetActorLocationAndRotation(OwnerState.Location, OwnerState.Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	MovementComponent->SetVelocity(OwnerState.Velocity);
+
+	// Replayed moves with input wake the kart again, as they did on the server.
+	if (OwnerState.bAsleep)
+	{
+		MovementComponent->GoToSleep();
+
+	}
 
 	// Clear tracked moved.
-	ClearAcknowledgedMoves(ServerState.PrevMove);
+	RecordMoveLatency();
+	ClearAcknowledgedMoves(OwnerState.AckedMoveId);
+
+	SendRate.OnAck(OwnerState.LastPacketId, OwnerState.PacketsLost, GoKartTime::TicksToSeconds(GoKartTime::GetSessionTicks()));
+
+	NetStats.Record(EGoKartNetStat::ReplayLength, UnacknowledgedMoves.Num() + (bHasPendingMove ? 1 : 0));
 
-	// Iterate through UnacknowledgedMoves and simulate move.
+	// Iterate through UnacknowledgedMoves and simulate move, less any of it the server state already includes.
+	float SkipTime = OwnerState.TimeIntoNextMove;
 	for (const FGoKartMove& Move : UnacknowledgedMoves)
 	{
-		MovementComponent->SimulateMove(Move);
+		ReplaySteps(Move, SkipTime);
 
 	}
 
+	// The pending move has already been simulated locally, so it must be replayed as well.
+	if (bHasPendingMove)
+	{
+		ReplaySteps(PendingMove, SkipTime);
+
+	}
+
+	const float CorrectionDistance = FVector::Dist(PredictedLocation, GetOwner()->GetActorLocation());
+	NetStats.Record(EGoKartNetStat::CorrectionDistance, (uint32)(CorrectionDistance * 10.f));
+
+#if ENABLE_KART_NET_DEBUG
+	RecordCorrection(CorrectionDistance);
+#endif // ENABLE_KART_NET_DEBUG
+
 }
 
 // As client to other clients.
-void UGoKartMovementReplicator::SimulatedProxy_OnRep_ServerState()
+void UGoKartMovementReplicator::OnRep_ObserverState()
 {
-	if (MovementComponent == nullptr) return;
+	if (MovementComponent == nullptr || GetOwnerRole() != ROLE_SimulatedProxy) return;
+
+#if ENABLE_KART_NET_DEBUG
+	RecordServerStateReceived();
+#endif // ENABLE_KART_NET_DEBUG
 
 	// Update client variables.
 	ClientTimeBetweenLastUpdates = ClientTimeSinceUpdate;
@@ -202,18 +886,67 @@ void UGoKartMovementReplicator::SimulatedProxy_OnRep_ServerState()
 	}
 	ClientStartVelocity = MovementComponent->GetVelocity();
 
-	GetOwner()->SetActorTransform(ServerState.Transform);
+#if ENABLE_KART_NET_DEBUG
+	// For observed karts, how far the interpolated kart was from where the server says it is.
+	RecordCorrection(FVector::Dist(ClientStartTransform.GetLocation(), ObserverState.Location));
+#endif // ENABLE_KART_NET_DEBUG
+
+	GetOwner()->SetActorLocationAndRotation(ObserverState.Location, ObserverState.Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	MovementComponent->SetVelocity(ObserverState.Velocity);
+
+	// Near the local kart, catch up to its timeline so it collides with where this kart will be, not where it was.
+	const float PredictionTime = GetPredictionTime();
+	bPredicting = PredictionTime >= 0.f;
+	if (bPredicting)
+	{
+		// The local kart was already pushed when it met this one in PredictTick, so catch up as a replay.
+		SimulateObservedInput(PredictionTime, true);
+
+		// The mesh moved with the root; put it back and let PredictTick close the gap.
+		if (MeshOffsetRoot != nullptr)
+		{
+			MeshOffsetRoot->SetWorldLocationAndRotation(ClientStartTransform.GetLocation(), ClientStartTransform.GetRotation());
+
+		}
+
+	}
 
 }
 
-void UGoKartMovementReplicator::ClearAcknowledgedMoves(FGoKartMove PrevMove)
+void UGoKartMovementReplicator::RecordMoveLatency()
+{
+	// Moves made before the first clock sync carry no timestamp, and a move is only measured the first time it's acknowledged.
+	if (OwnerState.AckedMoveReceiveTicks <= 0) return;
+	const FGoKartMove* AckedMove = UnacknowledgedMoves.FindByPredicate([this](const FGoKartMove& Move) { return Move.MoveId == OwnerState.AckedMoveId; });
+	if (AckedMove == nullptr || AckedMove->TimeStamp <= 0) return;
+
+	// Timestamps are on our estimate of the server's clock, so they compare directly with the server's.
+	const int64 InputToServer = FMath::Max<int64>(0, OwnerState.AckedMoveReceiveTicks - AckedMove->TimeStamp);
+	const int64 ServerQueue = FMath::Max<int64>(0, OwnerState.AckedMoveSimulateTicks - OwnerState.AckedMoveReceiveTicks);
+	const int64 InputToAck = FMath::Max<int64>(0, GetSynchronizedServerTicks() - AckedMove->TimeStamp);
+
+	LastMoveLatency.InputToServer = GoKartTime::TicksToSeconds(InputToServer);
+	LastMoveLatency.ServerQueue = GoKartTime::TicksToSeconds(ServerQueue);
+	LastMoveLatency.InputToAck = GoKartTime::TicksToSeconds(InputToAck);
+
+	NetStats.Record(EGoKartNetStat::InputToServer, (uint32)InputToServer);
+	NetStats.Record(EGoKartNetStat::ServerQueueTime, (uint32)ServerQueue);
+	NetStats.Record(EGoKartNetStat::InputToAck, (uint32)InputToAck);
+
+	SET_FLOAT_STAT(STAT_KartInputToServer, LastMoveLatency.InputToServer * 1000.f);
+	SET_FLOAT_STAT(STAT_KartServerQueue, LastMoveLatency.ServerQueue * 1000.f);
+	SET_FLOAT_STAT(STAT_KartInputToAck, LastMoveLatency.InputToAck * 1000.f);
+
+}
+
+void UGoKartMovementReplicator::ClearAcknowledgedMoves(uint32 AckedMoveId)
 {
 	TArray<FGoKartMove> FreshMoves;
 
 	for (const FGoKartMove& Move : UnacknowledgedMoves)
 	{
 		// If next move happens after prev move update FreshMoves.
-		if (Move.TimeStamp > PrevMove.TimeStamp)
+		if (FGoKartMove::IsNewer(Move.MoveId, AckedMoveId))
 		{
 			FreshMoves.Add(Move);
 
@@ -226,43 +959,224 @@ void UGoKartMovementReplicator::ClearAcknowledgedMoves(FGoKartMove PrevMove)
 
 }
 
-// Implementation of the Server_MoveForward function. Suffix: '_Implementation'
-void UGoKartMovementReplicator::Server_SendMove_Implementation(FGoKartMove Move)
+// Implementation of the Server_SendMoves function. Suffix: '_Implementation'
+void UGoKartMovementReplicator::Server_SendMoves_Implementation(const TArray<FGoKartMove>& Moves, uint16 PacketId)
 {
 	if (MovementComponent == nullptr) return;
 
-	// Simulate move on server.
-	ClientSimulatedTime += Move.DeltaTime;
-	MovementComponent->SimulateMove(Move);
+	// Count packets that never arrived. One arriving late after a newer one isn't counted twice.
+	if (!bHasReceivedPacket)
+	{
+		bHasReceivedPacket = true;
+		LastReceivedPacketId = PacketId;
 
-	UpdateServerState(Move);
+	}
+	else if (static_cast<int16>(PacketId - LastReceivedPacketId) > 0)
+	{
+		PacketsLost += static_cast<uint16>(PacketId - LastReceivedPacketId - 1);
+		LastReceivedPacketId = PacketId;
+
+	}
+
+	for (const FGoKartMove& Move : Moves)
+	{
+		// Moves are repeated until acknowledged, so most packets start with some we already have.
+		if (LastReceivedMoveId != 0 && !FGoKartMove::IsNewer(Move.MoveId, LastReceivedMoveId)) continue;
+
+		ReceiveMove(Move);
+		LastReceivedMoveId = Move.MoveId;
+
+	}
+
+}
+
+void UGoKartMovementReplicator::ReceiveMove(const FGoKartMove& Move)
+{
+	// Start the client's clock from when its first move arrived. The move's timestamp is the client's word, so it's only used for latency statistics.
+	if (!bClientSimulatedTimeStarted)
+	{
+		ClientSimulatedTime = GoKartTime::TicksToSeconds(GoKartTime::GetSessionTicks()) - Move.GetDuration();
+		bClientSimulatedTimeStarted = true;
+
+	}
+
+	// Buffer the move, it is simulated in ServerTick.
+	ClientSimulatedTime += Move.GetDuration();
+	FGoKartMove ReceivedMove = Move;
+	ReceivedMove.ReceiveTicks = GoKartTime::GetSessionTicks();
+	ServerInputBuffer.AddMove(ReceivedMove, GoKartTime::TicksToSeconds(ReceivedMove.ReceiveTicks));
 
 }
 
-// Server validation of the Server_MoveForward function. Suffix: '_Validate'
-bool UGoKartMovementReplicator::Server_SendMove_Validate(FGoKartMove Move)
+// Server validation of the Server_SendMoves function. Suffix: '_Validate'
+bool UGoKartMovementReplicator::Server_SendMoves_Validate(const TArray<FGoKartMove>& Moves, uint16 PacketId)
 {
 	/**
 	* '_Validate' methods are where anti-cheat logic is placed.
 	*
 	* Here we check that our client is making valid moves and not manipulating time variables.
+	* Moves are stamped with the client's synchronized clock, which can be slightly ahead of ours, hence the tolerance.
 	*
 	*/
-	float ProposedTime = ClientSimulatedTime + Move.DeltaTime;
-	bool ClientNotRunningAhead = ProposedTime < GetWorld()->GetGameState()->GetServerWorldTimeSeconds();
-	if (!ClientNotRunningAhead)
+	if (Moves.Num() > FMath::Max(1, MaxMovesPerPacket))
 	{
-		UE_LOG(LogTemp, Error, TEXT("Client is running too fast."));
+		UE_LOG(LogTemp, Error, TEXT("Received too many moves in one packet."));
 		return false;
 
 	}
-	if (!Move.IsValid())
+
+	// Only moves we haven't had yet advance the client's clock. Before the first, it starts as ReceiveMove will start it.
+	const double ServerTime = GoKartTime::TicksToSeconds(GoKartTime::GetSessionTicks());
+	const double MaxProposedTime = ServerTime + MaxClientTimeAhead;
+	bool bStarted = bClientSimulatedTimeStarted;
+	double ProposedTime = ClientSimulatedTime;
+	for (const FGoKartMove& Move : Moves)
 	{
-		UE_LOG(LogTemp, Error, TEXT("Received invalid move."));
-		return false;
+		if (!Move.IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Received invalid move."));
+			return false;
+
+		}
+		if (LastReceivedMoveId != 0 && !FGoKartMove::IsNewer(Move.MoveId, LastReceivedMoveId)) continue;
+
+		if (!bStarted)
+		{
+			ProposedTime = ServerTime - Move.GetDuration();
+			bStarted = true;
+
+		}
+		ProposedTime += Move.GetDuration();
+		bool ClientNotRunningAhead = ProposedTime < MaxProposedTime;
+		if (!ClientNotRunningAhead)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Client is running too fast."));
+			return false;
+
+		}
 
 	}
 
 	return true;
 
 }
+
+#if ENABLE_KART_NET_DEBUG
+static FString GetEnumText(ENetRole Role)
+{
+	// Used to visualize remote roles of actors.
+	switch (Role)
+	{
+	case ROLE_None:
+		return "None";
+	case ROLE_SimulatedProxy:
+		return "SimulatedProxy";
+	case ROLE_AutonomousProxy:
+		return "AutonomousProxy";
+	case ROLE_Authority:
+		return "Authority";
+	default:
+		return "ERROR";
+	}
+
+}
+
+void UGoKartMovementReplicator::RecordServerStateReceived()
+{
+	const float Now = GetWorld()->GetRealTimeSeconds();
+	const float Interval = Now - NetDebugLastServerStateTime;
+	if (NetDebugLastServerStateTime > 0.f && Interval > KINDA_SMALL_NUMBER)
+	{
+		NetDebugReplicationRate = FMath::Lerp(NetDebugReplicationRate, 1.f / Interval, 0.2f);
+
+	}
+	NetDebugLastServerStateTime = Now;
+
+}
+
+void UGoKartMovementReplicator::RecordCorrection(float Distance)
+{
+	LastCorrectionDistance = Distance;
+	CorrectionHistory[CorrectionHistoryHead] = Distance;
+	CorrectionHistoryHead = (CorrectionHistoryHead + 1) % NetDebugHistorySize;
+
+}
+
+void UGoKartMovementReplicator::DrawNetDebug(UCanvas* Canvas, APlayerController* PlayerController)
+{
+	if (CVarKartNetDebug.GetValueOnGameThread() == 0) return;
+	// The service draws every viewport, including other PIE worlds, so only draw into our own.
+	if (Canvas == nullptr || PlayerController == nullptr || PlayerController->GetWorld() != GetWorld()) return;
+
+	// Anchor the overlay above the kart, skipping karts behind the camera.
+	const FVector ScreenLocation = Canvas->Project(GetOwner()->GetActorLocation() + FVector(0.f, 0.f, 150.f));
+	if (ScreenLocation.Z <= 0.f) return;
+
+	float RoundTripTime = 0.f;
+	const APawn* Pawn = Cast<APawn>(GetOwner());
+	if (GetOwnerRole() == ROLE_AutonomousProxy && ClockSync.HasEstimate())
+	{
+		RoundTripTime = ClockSync.GetRoundTripTime() * 1000.f;
+
+	}
+	else if (Pawn != nullptr && Pawn->PlayerState != nullptr)
+	{
+		// Replicated ping is stored in ms / 4.
+		RoundTripTime = Pawn->PlayerState->Ping * 4.f;
+
+	}
+
+	UFont* Font = GEngine->GetSmallFont();
+	const float LineHeight = 12.f;
+	float X = ScreenLocation.X;
+	float Y = ScreenLocation.Y;
+
+	Canvas->SetDrawColor(FColor::White);
+	Canvas->DrawText(Font, GetEnumText(GetOwnerRole()), X, Y);
+	Canvas->DrawText(Font, FString::Printf(TEXT("Pending moves: %d"), UnacknowledgedMoves.Num() + (bHasPendingMove ? 1 : 0)), X, Y += LineHeight);
+	Canvas->DrawText(Font, FString::Printf(TEXT("Last correction: %.1f cm"), LastCorrectionDistance), X, Y += LineHeight);
+	Canvas->DrawText(Font, FString::Printf(TEXT("Replication: %.1f Hz"), NetDebugReplicationRate), X, Y += LineHeight);
+	if (GetOwnerRole() == ROLE_AutonomousProxy)
+	{
+		Canvas->DrawText(Font, FString::Printf(TEXT("Send: %.0f Hz, redundancy %d, loss %.1f%%, queuing %.0f ms"),
+			SendRate.GetSendRate(), SendRate.GetRedundancy(), SendRate.GetLossRate() * 100.f, SendRate.GetQueuingDelay() * 1000.f), X, Y += LineHeight);
+		Canvas->DrawText(Font, FString::Printf(TEXT("Latency: to server %.0f ms, queued %.0f ms, to ack %.0f ms"),
+			LastMoveLatency.InputToServer * 1000.f, LastMoveLatency.ServerQueue * 1000.f, LastMoveLatency.InputToAck * 1000.f), X, Y += LineHeight);
+
+	}
+	Canvas->DrawText(Font, FString::Printf(TEXT("RTT: %.0f ms"), RoundTripTime), X, Y += LineHeight);
+
+	// Correction history, oldest on the left, scaled to the largest sample.
+	const float GraphWidth = 2.f * NetDebugHistorySize;
+	const float GraphHeight = 30.f;
+	const float GraphBottom = Y + LineHeight + GraphHeight;
+
+	float MaxCorrection = 10.f;
+	for (float Correction : CorrectionHistory)
+	{
+		MaxCorrection = FMath::Max(MaxCorrection, Correction);
+
+	}
+
+	FCanvasBoxItem Frame(FVector2D(X, GraphBottom - GraphHeight), FVector2D(GraphWidth, GraphHeight));
+	Frame.SetColor(FLinearColor::Gray);
+	Canvas->DrawItem(Frame);
+
+	FVector2D PrevPoint;
+	for (int32 Sample = 0; Sample < NetDebugHistorySize; ++Sample)
+	{
+		const float Correction = CorrectionHistory[(CorrectionHistoryHead + Sample) % NetDebugHistorySize];
+		const FVector2D Point(X + Sample * (GraphWidth / NetDebugHistorySize), GraphBottom - GraphHeight * (Correction / MaxCorrection));
+		if (Sample > 0)
+		{
+			FCanvasLineItem Line(PrevPoint, Point);
+			Line.SetColor(FLinearColor::Yellow);
+			Canvas->DrawItem(Line);
+
+		}
+		PrevPoint = Point;
+
+	}
+
+}
+#endif // ENABLE_KART_NET_DEBUG
@@ -4,26 +4,145 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
-#include "GoKartMovementComponent.h"
+#include "Engine/NetSerialization.h"
+#include "GoKartMovementInterface.h"
+#include "GoKartClockSync.h"
+#include "GoKartInputBuffer.h"
+#include "GoKartNetStats.h"
+#include "GoKartSendRate.h"
 #include "GoKartMovementReplicator.generated.h"
 
+// Kart net-debug overlay, toggled with NetRacers.KartNetDebug. Never built into Shipping or dedicated server builds.
+#define ENABLE_KART_NET_DEBUG !(UE_BUILD_SHIPPING || UE_SERVER)
 
+class UCanvas;
+class APlayerController;
+class ANetworkRacersGameMode;
+class UGoKartMovementReplicator;
+
+
+// Server state the owning client reconciles against. Full precision, since any error here becomes a correction.
+USTRUCT()
+struct FGoKartOwnerState
+{
+	GENERATED_USTRUCT_BODY()
+
+	// Karts are never scaled, so location and rotation are sent rather than a whole transform.
+	UPROPERTY()
+	FVector Location;
+
+	UPROPERTY()
+	FQuat Rotation;
+
+	UPROPERTY()
+	FVector Velocity;
+
+	// Last of the client's moves included in this state.
+	UPROPERTY()
+	uint32 AckedMoveId = 0;
+
+	// Newest move packet the server has received, and a running count of those it never received. See FGoKartSendRate.
+	UPROPERTY()
+	uint16 LastPacketId = 0;
+
+	UPROPERTY()
+	uint16 PacketsLost = 0;
+
+	// When the server received the acknowledged move and when it finished simulating it, in GoKartTime ticks of its session clock.
+	UPROPERTY()
+	int64 AckedMoveReceiveTicks = 0;
+
+	UPROPERTY()
+	int64 AckedMoveSimulateTicks = 0;
+
+	// Time past the acknowledged move already in this state (s): physics substeps don't end on move boundaries. See IGoKartMovementInterface::SimulatesDuringPhysics.
+	UPROPERTY()
+	float TimeIntoNextMove = 0.f;
+
+	// The kart is asleep on the server, so the client puts its own to sleep too. See IGoKartMovementInterface::IsAsleep.
+	UPROPERTY()
+	bool bAsleep = false;
+
+};
+
+/**
+* Server state other clients interpolate towards.
+* Observers smooth between updates anyway, so it is quantized: location to 0.1 cm, rotation to 16 bits per axis,
+* velocity to 1 cm/s and input to 8 bits per axis.
+*
+*/
 USTRUCT()
-struct FGoKartState
+struct FGoKartObserverState
 {
 	GENERATED_USTRUCT_BODY()
 
 	UPROPERTY()
-	FTransform Transform;
+	FVector Location;
 
+	UPROPERTY()
+	FRotator Rotation;
+
+	// m/s
 	UPROPERTY()
 	FVector Velocity;
 
+	// Input of the last move the server simulated, which observers near the kart predict it forward with.
 	UPROPERTY()
-	FGoKartMove PrevMove;
+	float Throttle = 0.f;
+
+	UPROPERTY()
+	float SteeringThrow = 0.f;
+
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
 
 };
 
+template<>
+struct TStructOpsTypeTraits<FGoKartObserverState> : public TStructOpsTypeTraitsBase2<FGoKartObserverState>
+{
+	enum
+	{
+		WithNetSerializer = true,
+	};
+};
+
+// Where the time went for one of the owning client's moves (s), measured when its acknowledgement arrives.
+struct FGoKartMoveLatency
+{
+	// From the move being made to the server receiving it.
+	float InputToServer = 0.f;
+
+	// Held in the server's input buffer.
+	float ServerQueue = 0.f;
+
+	// From the move being made to its acknowledgement arriving back.
+	float InputToAck = 0.f;
+
+};
+
+// Publishes the server state of movement that simulates during physics, once physics has run. See IGoKartMovementInterface::SimulatesDuringPhysics.
+USTRUCT()
+struct FGoKartReplicatorPostPhysicsTickFunction : public FTickFunction
+{
+	GENERATED_USTRUCT_BODY()
+
+	UGoKartMovementReplicator* Target = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+
+	virtual FString DiagnosticMessage() override;
+
+};
+
+template<>
+struct TStructOpsTypeTraits<FGoKartReplicatorPostPhysicsTickFunction> : public TStructOpsTypeTraitsBase2<FGoKartReplicatorPostPhysicsTickFunction>
+{
+	enum
+	{
+		WithCopy = false,
+	};
+};
+
 struct FHermiteCubicSpline
 {
 	FVector StartLocation, StartDerivative, TargetLocation, TargetDerivative;
@@ -44,13 +163,78 @@ public:
 
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	// On the owning client, our estimate of the server's session clock in GoKartTime ticks, or 0 before the first exchange. Monotonic.
+	int64 GetSynchronizedServerTicks() const;
+
+	// On the owning client, the estimated round trip time to the server (s).
+	float GetRoundTripTime() const { return ClockSync.GetRoundTripTime(); };
+
+	// On the owning client, the latency of the last move the server acknowledged. See NetRacers.KartLatency.
+	const FGoKartMoveLatency& GetLastMoveLatency() const { return LastMoveLatency; };
+
+	const FGoKartNetStats& GetNetStats() const { return NetStats; };
+
+	// Hand the kart's stats to FGoKartNetStatsCollector and start afresh, eg. when it leaves play or goes back to the pool.
+	void SubmitNetStats();
+
+	// On the server, forget the moves and clock of the client that last owned the kart, eg. when a pooled pawn is reused.
+	// Clients forget their side of it too, see ResetCount.
+	void ResetServerInput();
+
+	// On the server, whether the kart may be replicated to Viewer yet. See AGoKartSnapshotStream and ANetworkRacersGameMode::IsKartAdmittedFor.
+	bool IsAdmittedFor(const AActor* Viewer) const;
+
+	// Record of this kart in its race's snapshot, INDEX_NONE if it has none.
+	int32 GetKartId() const { return KartId; };
+
+	// On the server, the race instance the kart is racing in, INDEX_NONE while it isn't racing. See ANetworkRacersGameMode.
+	// The kart holds a snapshot record only while it is racing, so pawns parked in the pool aren't sent to joiners.
+	void SetRaceInstanceId(int32 InRaceInstanceId);
+	int32 GetRaceInstanceId() const { return RaceInstanceId; };
+
+	// On the server, publish the state of a kart it drives itself, as TickComponent would. See AGoKartAIManager.
+	void UpdateServerDrivenState();
+
+	// Also switches the tick after physics.
+	virtual void SetComponentTickEnabled(bool bEnabled) override;
+
 protected:
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void RegisterComponentTickFunctions(bool bRegister) override;
+
 private:
-	void ClearAcknowledgedMoves(FGoKartMove PrevMove);
+	friend struct FGoKartReplicatorPostPhysicsTickFunction;
+
+	void ClearAcknowledgedMoves(uint32 AckedMoveId);
+
+	// Break down the latency of the move OwnerState acknowledges, before it is cleared.
+	void RecordMoveLatency();
+
+	void QueueMove(const FGoKartMove& Move);
 
-	void UpdateServerState(const FGoKartMove& Move);
+	void FlushPendingMove();
+
+	void SendMoves();
+
+	// Simulate each of Move's steps in turn, as the client predicted them.
+	void SimulateSteps(const FGoKartMove& Move);
+
+	// Replay each of Move's steps in turn, less the first SkipTime (s) the server state already covers. SkipTime is reduced by what was skipped.
+	void ReplaySteps(const FGoKartMove& Move, float& SkipTime);
+
+	// Publish the kart's state after LastMove, the newest move the server has simulated for it.
+	void UpdateServerState(const FGoKartMove& LastMove);
+
+	void ServerTick(float DeltaTime);
+
+	void PostPhysicsTick();
+
+	void UpdateNetSleep();
+
+	void WakeNet();
 
 	void ClientTick(float DeltaTime);
 
@@ -64,34 +248,184 @@ private:
 
 	float VelocityToDerivative();
 
+	// How far ahead of ObserverState the local player's kart is (s), or negative if this kart isn't near enough to predict.
+	float GetPredictionTime() const;
+
+	// Simulate the observed kart for Time (s) on the input the server last simulated it with.
+	// bReplay re-runs time the kart has already been through, so contacts don't push the karts it meets again.
+	void SimulateObservedInput(float Time, bool bReplay);
+
+	void PredictTick(float DeltaTime);
+
 	/**
-	* To replicate movement over a server we begin by applying Server, Reliable, WithValidation as properties in the UFUNCTION().
+	* To replicate movement over a server we begin by applying Server, WithValidation as properties in the UFUNCTION().
 	* Prefix function name with 'Server_'. This is the new name that we will bind our input to in the cpp.
 	* Definitions of these functions will be split between 2 functions with different suffixes: '_Implementation' & '_Validate' (see cpp).
 	*
+	* Unreliable: a packet carries every move not sent before plus the last few unacknowledged ones, so a lost packet's
+	* moves usually arrive in the next one instead of stalling everything behind a resend. See FGoKartSendRate.
+	*
 	*/
-	UFUNCTION(Server, Reliable, WithValidation)
-	void Server_SendMove(FGoKartMove Move);
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void Server_SendMoves(const TArray<FGoKartMove>& Moves, uint16 PacketId);
+
+	void ReceiveMove(const FGoKartMove& Move);
+
+	// Clock synchronization exchange, see FGoKartClockSync. Unreliable since a lost exchange is simply skipped.
+	UFUNCTION(Server, Unreliable, WithValidation)
+	void Server_RequestClockSync(int64 ClientSendTicks);
+
+	UFUNCTION(Client, Unreliable)
+	void Client_ReceiveClockSync(int64 ClientSendTicks, int64 ServerTicks);
+
+	void ClientClockSyncTick(float DeltaTime);
+
+	FGoKartClockSync ClockSync;
+
+	// Replicated only to the owning client.
+	UPROPERTY(ReplicatedUsing = OnRep_OwnerState)
+	FGoKartOwnerState OwnerState;
 
-	UPROPERTY(ReplicatedUsing = OnRep_ServerState)
-	FGoKartState ServerState;
+	// Replicated to everyone but the owning client.
+	UPROPERTY(ReplicatedUsing = OnRep_ObserverState)
+	FGoKartObserverState ObserverState;
 
-	// Function called when ReplicatedTransform becomes replicated.
 	UFUNCTION()
-	void OnRep_ServerState();
-	void AutonomousProxy_OnRep_ServerState();
-	void SimulatedProxy_OnRep_ServerState();
+	void OnRep_OwnerState();
+
+	UFUNCTION()
+	void OnRep_ObserverState();
+
+	UFUNCTION()
+	void OnRep_KartId();
+
+	UFUNCTION()
+	void OnRep_ResetCount();
+
+	// On clients, forget the moves, send rate and stats of the kart's previous driver.
+	void ResetClientInput();
+
+	// How often ObserverState is refreshed (Hz). OwnerState is refreshed every tick the server simulates the kart.
+	UPROPERTY(EditAnywhere)
+	float ObserverUpdateRate = 20.f;
+
+	float LastObserverUpdateTime = -1.f;
+
+	/**
+	* Observed karts within PredictionRadius (cm) of the local player's kart are predicted forward to where the local
+	* kart's timeline has them, rather than interpolated a round trip in the past, so bumps between the two are
+	* predicted instead of corrected. Prediction is bounded by MaxPredictionTime (s) and runs in steps of at most
+	* PredictionStep (s). The mesh closes on the predicted kart at PredictionSmoothingSpeed (1/s) to hide each update.
+	*
+	*/
+	UPROPERTY(EditAnywhere)
+	float PredictionRadius = 5000.f;
+
+	UPROPERTY(EditAnywhere)
+	float MaxPredictionTime = 0.25f;
+
+	UPROPERTY(EditAnywhere)
+	float PredictionStep = 1.f / 30.f;
+
+	UPROPERTY(EditAnywhere)
+	float PredictionSmoothingSpeed = 10.f;
+
+	bool bPredicting = false;
+
+	// Changes when a pooled pawn is reused, so it is replicated throughout rather than only initially.
+	UPROPERTY(ReplicatedUsing = OnRep_KartId)
+	int32 KartId = INDEX_NONE;
+
+	// Bumped by ResetServerInput, so clients reset along with the server when a pooled pawn is reused.
+	UPROPERTY(ReplicatedUsing = OnRep_ResetCount)
+	uint8 ResetCount = 0;
+
+	int32 RaceInstanceId = INDEX_NONE;
+
+	/**
+	* On the server, while a kart without a remote driver is asleep (see IGoKartMovementInterface::IsAsleep) it goes
+	* dormant. Dormancy would also close the channel a driver's moves arrive by, so driven karts only stop changing.
+	*
+	*/
+	bool bNetAsleep = false;
+	bool bNetDormant = false;
+
+	// On the server, the game mode whose kart snapshot we keep up to date.
+	TWeakObjectPtr<ANetworkRacersGameMode> SnapshotGameMode;
 
 	TArray<FGoKartMove> UnacknowledgedMoves;
 
+	/**
+	* Longest run of identical steps (s) merged into a single move. The run is flushed whenever a packet is due, so
+	* merging never delays a send; this only bounds how much one move can stand for.
+	*
+	*/
+	UPROPERTY(EditAnywhere, meta = (ClampMin = "0.0"))
+	float MaxCoalescedMoveTime = 0.1f;
+
+	// Move that has been simulated locally but not yet sent, while identical input keeps extending it.
+	FGoKartMove PendingMove;
+	bool bHasPendingMove;
+
+	// MoveId for the next move sent to the server.
+	uint32 NextMoveId = 1;
+
+	// Newest moves in UnacknowledgedMoves that haven't been sent yet.
+	int32 NumUnsentMoves = 0;
+
+	double LastSendTime = -DBL_MAX;
+
+	// Bounds the move send rate (Hz) and redundancy (moves repeated per packet) are adapted within.
+	UPROPERTY(EditAnywhere)
+	float MinSendRate = 10.f;
+
+	UPROPERTY(EditAnywhere)
+	float MaxSendRate = 60.f;
+
+	UPROPERTY(EditAnywhere)
+	int32 MaxRedundancy = 3;
+
+	// Most moves in one packet. Also bounds what the server accepts.
+	UPROPERTY(EditAnywhere)
+	int32 MaxMovesPerPacket = 16;
+
+	FGoKartSendRate SendRate;
+
+	// On the server, the newest move received from the client, and the packet loss reported back in OwnerState.
+	uint32 LastReceivedMoveId = 0;
+	bool bHasReceivedPacket = false;
+	uint16 LastReceivedPacketId = 0;
+	uint16 PacketsLost = 0;
+
 	float ClientTimeSinceUpdate;
 	float ClientTimeBetweenLastUpdates;
 	FTransform ClientStartTransform;
 	FVector ClientStartVelocity;
-	float ClientSimulatedTime;
+	// On the server, the owning client's clock as implied by the moves it has sent (s on our session clock).
+	double ClientSimulatedTime;
+	bool bClientSimulatedTimeStarted;
+
+	// On the server, moves received from the owning client waiting to be simulated.
+	FGoKartInputBuffer ServerInputBuffer;
+
+	// On the server, moves handed to movement that simulates during physics which physics hasn't finished yet, oldest first.
+	TArray<FGoKartMove> InFlightMoves;
 
+	FGoKartReplicatorPostPhysicsTickFunction PostPhysicsTickFunction;
+
+	// Most moves the server simulates for this kart in one tick while draining a backlog, bounding its per-tick cost.
+	UPROPERTY(EditAnywhere)
+	int32 MaxMovesPerTick = 4;
+
+	// How far ahead of the server's clock a client's simulated time may get before it is rejected (s).
+	UPROPERTY(EditAnywhere)
+	float MaxClientTimeAhead = 0.1f;
+
+	// Component on the owner implementing IGoKartMovementInterface, eg. UGoKartMovementComponent.
 	UPROPERTY()
-	UGoKartMovementComponent* MovementComponent;
+	UActorComponent* MovementComponentObject;
+
+	IGoKartMovementInterface* MovementComponent;
 
 	UPROPERTY()
 	USceneComponent* MeshOffsetRoot;
@@ -99,4 +433,29 @@ private:
 	UFUNCTION(BlueprintCallable)
 	void SetMeshOffsetRoot(USceneComponent* Root) { MeshOffsetRoot = Root; };
 
+	// Netcode histograms for this kart, handed to FGoKartNetStatsCollector by SubmitNetStats.
+	FGoKartNetStats NetStats;
+
+	FGoKartMoveLatency LastMoveLatency;
+
+#if ENABLE_KART_NET_DEBUG
+	void RecordServerStateReceived();
+
+	void RecordCorrection(float Distance);
+
+	void DrawNetDebug(UCanvas* Canvas, APlayerController* PlayerController);
+
+	FDelegateHandle NetDebugDrawHandle;
+
+	// Smoothed rate at which server state arrives (updates per second).
+	float NetDebugReplicationRate;
+	float NetDebugLastServerStateTime;
+
+	// Ring buffer of recent correction distances (cm), newest at CorrectionHistoryHead - 1.
+	static const int32 NetDebugHistorySize = 64;
+	float CorrectionHistory[NetDebugHistorySize];
+	int32 CorrectionHistoryHead;
+	float LastCorrectionDistance;
+#endif // ENABLE_KART_NET_DEBUG
+
 };
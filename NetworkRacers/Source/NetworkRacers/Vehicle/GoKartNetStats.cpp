@@ -0,0 +1,200 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartNetStats.h"
+#include "Engine/World.h"
+#include "Async/Async.h"
+#include "Misc/App.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/DateTime.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+namespace GoKartNetStats
+{
+	const TCHAR* StatNames[] = { TEXT("RoundTripTime"), TEXT("PendingMoves"), TEXT("CorrectionDistance"), TEXT("ReplayLength"), TEXT("ServerMoveTime"), TEXT("InputToServer"), TEXT("ServerQueueTime"), TEXT("InputToAck") };
+	const TCHAR* StatUnits[] = { TEXT("us"), TEXT("moves"), TEXT("mm"), TEXT("moves"), TEXT("us"), TEXT("us"), TEXT("us"), TEXT("us") };
+	static_assert(ARRAY_COUNT(StatNames) == (int32)EGoKartNetStat::Num, "Every stat needs a name.");
+	static_assert(ARRAY_COUNT(StatUnits) == (int32)EGoKartNetStat::Num, "Every stat needs a unit.");
+
+	void AppendRows(FString& Out, const FString& Scope, const FString& KartName, const FGoKartNetStats& Stats)
+	{
+		for (int32 Stat = 0; Stat < (int32)EGoKartNetStat::Num; ++Stat)
+		{
+			const FGoKartHistogram& Histogram = Stats.Histograms[Stat];
+			if (Histogram.GetCount() == 0) continue;
+
+			Out += FString::Printf(TEXT("%s,%s,%s,%s,%llu,%u,%u,%u,%u,%u\n"), *Scope, *KartName, StatNames[Stat], StatUnits[Stat],
+				Histogram.GetCount(), Histogram.GetMin(), Histogram.GetPercentile(50.f), Histogram.GetPercentile(90.f), Histogram.GetPercentile(99.f), Histogram.GetMax());
+
+		}
+
+	}
+}
+
+FGoKartHistogram::FGoKartHistogram()
+	: TotalCount(0)
+	, MinValue(MAX_uint32)
+	, MaxValue(0)
+{
+	FMemory::Memzero(Counts);
+
+}
+
+int32 FGoKartHistogram::GetBucketIndex(uint32 Value)
+{
+	if (Value < 2 * SubBucketCount) return Value;
+
+	// Keep the top SubBucketBits + 1 bits of the value.
+	const int32 Shift = FMath::FloorLog2(Value) - SubBucketBits;
+	return SubBucketCount + Shift * SubBucketCount + (int32)(Value >> Shift) - SubBucketCount;
+
+}
+
+uint32 FGoKartHistogram::GetBucketValue(int32 BucketIndex)
+{
+	if (BucketIndex < 2 * SubBucketCount) return BucketIndex;
+
+	// Middle of the bucket's range.
+	const int32 Shift = (BucketIndex - SubBucketCount) / SubBucketCount;
+	const uint32 Mantissa = SubBucketCount + (BucketIndex - SubBucketCount) % SubBucketCount;
+	return (Mantissa << Shift) + ((1u << Shift) >> 1);
+
+}
+
+void FGoKartHistogram::Record(uint32 Value)
+{
+	++Counts[GetBucketIndex(Value)];
+	++TotalCount;
+	MinValue = FMath::Min(MinValue, Value);
+	MaxValue = FMath::Max(MaxValue, Value);
+
+}
+
+void FGoKartHistogram::Merge(const FGoKartHistogram& Other)
+{
+	for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		Counts[Bucket] += Other.Counts[Bucket];
+
+	}
+	TotalCount += Other.TotalCount;
+	MinValue = FMath::Min(MinValue, Other.MinValue);
+	MaxValue = FMath::Max(MaxValue, Other.MaxValue);
+
+}
+
+uint32 FGoKartHistogram::GetPercentile(float Percentile) const
+{
+	if (TotalCount == 0) return 0;
+
+	const uint64 Rank = FMath::Max<uint64>(1, FMath::CeilToInt(TotalCount * FMath::Clamp(Percentile, 0.f, 100.f) / 100.f));
+	uint64 Cumulative = 0;
+	for (int32 Bucket = 0; Bucket < NumBuckets; ++Bucket)
+	{
+		Cumulative += Counts[Bucket];
+		if (Cumulative >= Rank)
+		{
+			return FMath::Clamp(GetBucketValue(Bucket), GetMin(), MaxValue);
+
+		}
+
+	}
+
+	return MaxValue;
+
+}
+
+bool FGoKartNetStats::IsEmpty() const
+{
+	for (const FGoKartHistogram& Histogram : Histograms)
+	{
+		if (Histogram.GetCount() > 0) return false;
+
+	}
+
+	return true;
+
+}
+
+FGoKartNetStatsCollector& FGoKartNetStatsCollector::Get()
+{
+	static FGoKartNetStatsCollector Collector;
+	return Collector;
+
+}
+
+FGoKartNetStatsCollector::FGoKartNetStatsCollector()
+{
+	FWorldDelegates::OnWorldCleanup.AddRaw(this, &FGoKartNetStatsCollector::OnWorldCleanup);
+	FCoreDelegates::OnPreExit.AddRaw(this, &FGoKartNetStatsCollector::WaitForWrites);
+
+}
+
+FGoKartNetStatsCollector::~FGoKartNetStatsCollector()
+{
+	FWorldDelegates::OnWorldCleanup.RemoveAll(this);
+	FCoreDelegates::OnPreExit.RemoveAll(this);
+	WaitForWrites();
+
+}
+
+void FGoKartNetStatsCollector::WaitForWrites()
+{
+	for (TFuture<void>& Write : Writes)
+	{
+		Write.Wait();
+
+	}
+	Writes.Reset();
+
+}
+
+void FGoKartNetStatsCollector::SubmitKart(UWorld* World, const FString& KartName, const FGoKartNetStats& Stats)
+{
+	if (World == nullptr || Stats.IsEmpty()) return;
+
+	PendingKarts.FindOrAdd(World).Add({ KartName, MakeShared<FGoKartNetStats, ESPMode::ThreadSafe>(Stats) });
+
+}
+
+void FGoKartNetStatsCollector::OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources)
+{
+	TArray<FKartEntry> Karts;
+	if (!PendingKarts.RemoveAndCopyValue(World, Karts) || Karts.Num() == 0) return;
+
+	const FString NetMode = World->GetNetMode() == NM_Client ? TEXT("Client") : TEXT("Server");
+	const FString Filename = FPaths::ProjectSavedDir() / TEXT("NetStats") / FString::Printf(TEXT("%s_%s_%s.csv"), *World->GetMapName(), *NetMode, *FDateTime::Now().ToString());
+	const FString Build = FString::Printf(TEXT("%s %s"), *FEngineVersion::Current().ToString(), EBuildConfigurations::ToString(FApp::GetBuildConfiguration()));
+
+	// Forget writes that have finished.
+	Writes.RemoveAll([](const TFuture<void>& Write) { return Write.IsReady(); });
+
+	// Merging and formatting a few hundred KB of histograms isn't worth a hitch at the end of the match.
+	Writes.Add(Async<void>(EAsyncExecution::ThreadPool, [Karts = MoveTemp(Karts), Filename, Build]()
+	{
+		FString Csv = FString::Printf(TEXT("# %s\nScope,Kart,Stat,Unit,Count,Min,P50,P90,P99,Max\n"), *Build);
+
+		FGoKartNetStats Match;
+		for (const FKartEntry& Kart : Karts)
+		{
+			GoKartNetStats::AppendRows(Csv, TEXT("Kart"), Kart.KartName, *Kart.Stats);
+			for (int32 Stat = 0; Stat < (int32)EGoKartNetStat::Num; ++Stat)
+			{
+				Match.Histograms[Stat].Merge(Kart.Stats->Histograms[Stat]);
+
+			}
+
+		}
+		GoKartNetStats::AppendRows(Csv, TEXT("Match"), TEXT("All"), Match);
+
+		if (!FFileHelper::SaveStringToFile(Csv, *Filename))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Couldn't write kart net stats to %s."), *Filename);
+
+		}
+
+	}));
+
+}
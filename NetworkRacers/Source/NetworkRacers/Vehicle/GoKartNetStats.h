@@ -0,0 +1,118 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+
+class UWorld;
+
+
+/**
+* Log-linear histogram in the style of HdrHistogram, in fixed memory.
+*
+* Values below 64 get a bucket each; above that every power of two is split into 32 buckets, so any recorded value
+* is reported to within about 3% however large it is. Recording is a couple of shifts and an increment, with no
+* allocation and no locking: each histogram has a single writer (the game thread).
+*
+*/
+class NETWORKRACERS_API FGoKartHistogram
+{
+public:
+	FGoKartHistogram();
+
+	void Record(uint32 Value);
+
+	void Merge(const FGoKartHistogram& Other);
+
+	// Value at or below which Percentile (0-100) of recorded values fall.
+	uint32 GetPercentile(float Percentile) const;
+
+	uint64 GetCount() const { return TotalCount; };
+	uint32 GetMin() const { return TotalCount > 0 ? MinValue : 0; };
+	uint32 GetMax() const { return MaxValue; };
+
+private:
+	static const int32 SubBucketBits = 5;
+	static const int32 SubBucketCount = 1 << SubBucketBits;
+	static const int32 NumBuckets = SubBucketCount + (32 - SubBucketBits) * SubBucketCount;
+
+	static int32 GetBucketIndex(uint32 Value);
+	static uint32 GetBucketValue(int32 BucketIndex);
+
+	uint32 Counts[NumBuckets];
+	uint64 TotalCount;
+	uint32 MinValue;
+	uint32 MaxValue;
+
+};
+
+enum class EGoKartNetStat : uint8
+{
+	// Clock sync round trip time (us), owning client.
+	RoundTripTime,
+	// Moves sent but not yet acknowledged when another is sent, owning client.
+	PendingMoves,
+	// Distance the kart moved when reconciled with the server (mm), owning client.
+	CorrectionDistance,
+	// Moves replayed per reconciliation, owning client.
+	ReplayLength,
+	// Time to simulate a tick's worth of a client's moves (us), server.
+	ServerMoveTime,
+	// From a move being made to the server receiving it (us), owning client.
+	InputToServer,
+	// From the server receiving a move to it being simulated (us), owning client.
+	ServerQueueTime,
+	// From a move being made to its acknowledgement arriving back (us), owning client.
+	InputToAck,
+
+	Num
+};
+
+// Netcode histograms for one kart, kept by its UGoKartMovementReplicator.
+struct NETWORKRACERS_API FGoKartNetStats
+{
+	FGoKartHistogram Histograms[(int32)EGoKartNetStat::Num];
+
+	void Record(EGoKartNetStat Stat, uint32 Value) { Histograms[(int32)Stat].Record(Value); };
+
+	bool IsEmpty() const;
+
+};
+
+/**
+* Gathers the stats of every kart in a world and, when the world is cleaned up at the end of the match, writes them
+* along with the whole match's merged histograms to Saved/NetStats/ on a thread pool thread. Writes still running
+* when the engine exits are waited for.
+*
+* Output is CSV: Scope,Kart,Stat,Unit,Count,Min,P50,P90,P99,Max, with the build on the first line.
+*
+*/
+class NETWORKRACERS_API FGoKartNetStatsCollector
+{
+public:
+	static FGoKartNetStatsCollector& Get();
+
+	// Hand over a kart's stats when it leaves play.
+	void SubmitKart(UWorld* World, const FString& KartName, const FGoKartNetStats& Stats);
+
+private:
+	FGoKartNetStatsCollector();
+	~FGoKartNetStatsCollector();
+
+	void OnWorldCleanup(UWorld* World, bool bSessionEnded, bool bCleanupResources);
+
+	void WaitForWrites();
+
+	// Stats are written on a thread pool thread, so they are shared thread-safely.
+	struct FKartEntry
+	{
+		FString KartName;
+		TSharedRef<FGoKartNetStats, ESPMode::ThreadSafe> Stats;
+	};
+
+	TMap<TWeakObjectPtr<UWorld>, TArray<FKartEntry>> PendingKarts;
+
+	TArray<TFuture<void>> Writes;
+
+};
@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSendRate.h"
+
+
+namespace GoKartSendRate
+{
+	// The link is treated as congested above either of these.
+	const float LossThreshold = 0.02f;
+	const float QueuingDelayThreshold = 0.05f;
+
+	// Multiplicative decrease and additive increase of the send rate (Hz).
+	const float SendRateDecrease = 0.75f;
+	const float SendRateIncrease = 2.f;
+
+	// Shortest time between adjustments, for very low round trip times (s).
+	const double MinAdjustInterval = 0.1;
+
+	// Weight of a new loss or delay sample in the smoothed values, as in TCP's RTT estimate.
+	const float SmoothingFactor = 1.f / 8.f;
+}
+
+FGoKartSendRate::FGoKartSendRate()
+	: MinSendRate(10.f)
+	, MaxSendRate(60.f)
+	, MaxRedundancy(3)
+	, SendRate(60.f)
+	, Redundancy(3)
+	, NextPacketId(0)
+	, bHasAck(false)
+	, LastAckedPacketId(0)
+	, LastPacketsLost(0)
+	, LossRate(0.f)
+	, SmoothedDelay(0.f)
+	, NextDelaySample(0)
+	, LastAdjustTime(-DBL_MAX)
+{
+	FMemory::Memzero(SentTimes);
+	FMemory::Memzero(SentPacketIds);
+	DelaySamples.Reserve(MaxDelaySamples);
+
+}
+
+void FGoKartSendRate::Configure(float InMinSendRate, float InMaxSendRate, int32 InMaxRedundancy)
+{
+	MinSendRate = FMath::Max(1.f, InMinSendRate);
+	MaxSendRate = FMath::Max(MinSendRate, InMaxSendRate);
+	MaxRedundancy = FMath::Max(0, InMaxRedundancy);
+
+	SendRate = MaxSendRate;
+	Redundancy = MaxRedundancy;
+
+}
+
+uint16 FGoKartSendRate::NoteSent(double LocalTime)
+{
+	const uint16 PacketId = NextPacketId++;
+	SentTimes[PacketId % MaxSentPackets] = LocalTime;
+	SentPacketIds[PacketId % MaxSentPackets] = PacketId;
+	return PacketId;
+
+}
+
+void FGoKartSendRate::OnAck(uint16 LastReceivedPacketId, uint16 PacketsLost, double LocalTime)
+{
+	if (!bHasAck)
+	{
+		bHasAck = true;
+		LastAckedPacketId = LastReceivedPacketId;
+		LastPacketsLost = PacketsLost;
+		return;
+
+	}
+
+	// Owner state is resent whenever the kart moves, so most acks report nothing new.
+	const uint16 Expected = LastReceivedPacketId - LastAckedPacketId;
+	if (Expected == 0 || Expected > 0x8000) return;
+
+	const uint16 Lost = PacketsLost - LastPacketsLost;
+	const float LossSample = FMath::Clamp(static_cast<float>(Lost) / Expected, 0.f, 1.f);
+	LossRate += (LossSample - LossRate) * GoKartSendRate::SmoothingFactor;
+
+	LastAckedPacketId = LastReceivedPacketId;
+	LastPacketsLost = PacketsLost;
+
+	// Includes the time the move waited in the server's input buffer, but that's part of the baseline as well.
+	const int32 Slot = LastReceivedPacketId % MaxSentPackets;
+	if (SentPacketIds[Slot] == LastReceivedPacketId)
+	{
+		const float DelaySample = static_cast<float>(LocalTime - SentTimes[Slot]);
+		SmoothedDelay = DelaySamples.Num() == 0 ? DelaySample : SmoothedDelay + (DelaySample - SmoothedDelay) * GoKartSendRate::SmoothingFactor;
+
+		if (DelaySamples.Num() < MaxDelaySamples)
+		{
+			DelaySamples.Add(DelaySample);
+
+		}
+		else
+		{
+			DelaySamples[NextDelaySample] = DelaySample;
+
+		}
+		NextDelaySample = (NextDelaySample + 1) % MaxDelaySamples;
+
+	}
+
+	Adjust(LocalTime);
+
+}
+
+float FGoKartSendRate::GetBaseDelay() const
+{
+	if (DelaySamples.Num() == 0) return 0.f;
+
+	return FMath::Min(DelaySamples);
+
+}
+
+void FGoKartSendRate::Adjust(double LocalTime)
+{
+	// Give the last change a round trip to show up in what the server reports.
+	if (LocalTime - LastAdjustTime < FMath::Max<double>(SmoothedDelay, GoKartSendRate::MinAdjustInterval)) return;
+	LastAdjustTime = LocalTime;
+
+	const bool bCongested = LossRate > GoKartSendRate::LossThreshold || GetQueuingDelay() > GoKartSendRate::QueuingDelayThreshold;
+	if (bCongested)
+	{
+		if (Redundancy > 0)
+		{
+			Redundancy /= 2;
+
+		}
+		else
+		{
+			SendRate = FMath::Max(MinSendRate, SendRate * GoKartSendRate::SendRateDecrease);
+
+		}
+
+	}
+	else if (SendRate < MaxSendRate)
+	{
+		SendRate = FMath::Min(MaxSendRate, SendRate + GoKartSendRate::SendRateIncrease);
+
+	}
+	else if (Redundancy < MaxRedundancy)
+	{
+		++Redundancy;
+
+	}
+
+}
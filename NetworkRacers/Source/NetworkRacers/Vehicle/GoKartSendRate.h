@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/**
+* Client-side congestion control for the moves sent to the server.
+*
+* Moves go out in unreliable packets, each repeating the last few moves the server hasn't acknowledged (redundancy) so
+* a lost packet costs nothing. The server echoes the newest packet id it has received and a running count of the ones
+* it never got, which gives us a loss rate and, from the packet's send time, a round trip time whose rise above the
+* lowest recently seen is delay queued up on the link.
+*
+* AIMD, adjusted at most once per round trip: while the link looks congested, redundancy is halved first and only once
+* there is none left is the send rate cut, since sending less often is what adds input latency. Once it recovers the
+* send rate is restored first, then redundancy.
+*
+*/
+class NETWORKRACERS_API FGoKartSendRate
+{
+public:
+	FGoKartSendRate();
+
+	// Bounds to adapt within. Starts at the highest rate and redundancy.
+	void Configure(float InMinSendRate, float InMaxSendRate, int32 InMaxRedundancy);
+
+	// Note a packet was sent at LocalTime (s). Returns its packet id.
+	uint16 NoteSent(double LocalTime);
+
+	// Server acknowledgement: newest packet it has received and the running count of packets it never received.
+	void OnAck(uint16 LastReceivedPacketId, uint16 PacketsLost, double LocalTime);
+
+	float GetSendInterval() const { return 1.f / SendRate; };
+	float GetSendRate() const { return SendRate; };
+	int32 GetRedundancy() const { return Redundancy; };
+
+	float GetLossRate() const { return LossRate; };
+
+	// Smoothed round trip time above the lowest recently seen (s).
+	float GetQueuingDelay() const { return FMath::Max(0.f, SmoothedDelay - GetBaseDelay()); };
+
+private:
+	float GetBaseDelay() const;
+
+	void Adjust(double LocalTime);
+
+	float MinSendRate;
+	float MaxSendRate;
+	int32 MaxRedundancy;
+
+	float SendRate;
+	int32 Redundancy;
+
+	// Send times of recent packets, by packet id.
+	static const int32 MaxSentPackets = 64;
+	double SentTimes[MaxSentPackets];
+	uint16 SentPacketIds[MaxSentPackets];
+	uint16 NextPacketId;
+
+	bool bHasAck;
+	uint16 LastAckedPacketId;
+	uint16 LastPacketsLost;
+
+	float LossRate;
+	float SmoothedDelay;
+
+	// Window of recent round trip times (ring buffer); the lowest is taken as the uncongested round trip time.
+	static const int32 MaxDelaySamples = 32;
+	TArray<float> DelaySamples;
+	int32 NextDelaySample;
+
+	double LastAdjustTime;
+
+};
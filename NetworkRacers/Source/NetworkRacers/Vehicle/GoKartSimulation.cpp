@@ -0,0 +1,212 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSimulation.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+
+namespace GoKartSimulation
+{
+	/**
+	* Models: each vehicle class's modelling choices as compile-time constants. The kernel is instantiated once per
+	* model, so the compiler folds the choices away and each kernel only contains the terms its class uses.
+	*
+	*/
+	struct FStandardModel
+	{
+		static const bool bAirResistance = true;
+		static const bool bArcadeSteering = false;
+
+		// Gravity the kart drives under (cm/s^2), given the world's.
+		static float GetGravityZ(float WorldGravityZ) { return WorldGravityZ; }
+
+		// Used when bArcadeSteering: turn rate at full lock (rad/s), reached from this forward speed up (m/s).
+		static constexpr float ArcadeTurnRate = 2.f;
+		static constexpr float ArcadeFullTurnSpeed = 5.f;
+	};
+
+	struct FNoDragModel : FStandardModel
+	{
+		static const bool bAirResistance = false;
+	};
+
+	struct FFixedGravityModel : FStandardModel
+	{
+		static float GetGravityZ(float WorldGravityZ) { return -980.f; }
+	};
+
+	struct FArcadeModel : FStandardModel
+	{
+		static const bool bArcadeSteering = true;
+	};
+
+	template<typename TModel>
+	FVector GetResistance(const FVector& Velocity, const FGoKartTuning& Tuning, float GravityZ)
+	{
+		/**
+		* Both resistances act against the direction the GoKart is travelling, so it is found once.
+		*
+		* Air resistance: -(Direction * Speed^2 * Drag)
+		*
+		* Rolling resistance: -(Direction * RollingResistanceCoefficient * NormalForce)
+		* GravityZ is the force of gravity in the Z axis.
+		* Unreal gets the value in relation to cm, and automatically applies a (-) sign to denote a downward force on the Z axis.
+		* ...therefore
+		* We divide by 100 to get the value in relation to m, and apply another (-) sign to make the value positive so we can use it.
+		*
+		* NormalForce is the force applied to counteract gravity. nF = M * G (NormalForce = Mass * Acceleration of gravity)
+		*
+		*/
+		const float Speed = Velocity.Size();
+		if (Speed < SMALL_NUMBER) return FVector::ZeroVector;
+
+		float AccelerationDueToGravity = -TModel::GetGravityZ(GravityZ) / 100;
+		float NormalForce = Tuning.Mass * AccelerationDueToGravity;
+
+		float Magnitude = Tuning.RollingResistanceCoefficient * NormalForce;
+		if (TModel::bAirResistance)
+		{
+			Magnitude += Speed * Speed * Tuning.DragCoefficient;
+
+		}
+
+		return Velocity * (-Magnitude / Speed);
+
+	}
+
+	template<typename TModel>
+	void ApplyRotation(FGoKartSimState& State, const FVector& Forward, float DeltaTime, float SteeringThrow, const FGoKartTuning& Tuning)
+	{
+		/**
+		* Calculate Steering Turning
+		* dx = dTheta * r
+		* Change in location along the turning circle in 1 second (dx).
+		* Angle calculated from dx in relation to the turning circle (dTheta).
+		* Radius of the turning circle (r).
+		*
+		* DotProduct(A, B) returns a float that represents an angular relationship between A and B.
+		* This relationship projects the length of vector B in the direction of vector A.
+		*
+		* dx is DeltaLocation
+		* r is MinTurningRadius
+		* dTheta is RotationAngle
+		*
+		* Arcade steering instead turns at a fixed rate, scaled down only at walking pace so a parked kart doesn't spin.
+		*
+		*/
+		float ForwardSpeed = FVector::DotProduct(Forward, State.Velocity);
+		float RotationAngle;
+		if (TModel::bArcadeSteering)
+		{
+			RotationAngle = FMath::Clamp(ForwardSpeed / TModel::ArcadeFullTurnSpeed, -1.f, 1.f) * TModel::ArcadeTurnRate * DeltaTime * SteeringThrow;
+
+		}
+		else
+		{
+			float DeltaLocation = ForwardSpeed * DeltaTime;
+			RotationAngle = (DeltaLocation / Tuning.MinTurningRadius) * SteeringThrow;
+
+		}
+		FQuat RotationDelta(State.Rotation.GetUpVector(), RotationAngle);
+
+		State.Velocity = RotationDelta.RotateVector(State.Velocity);
+		State.Rotation = RotationDelta * State.Rotation;
+
+	}
+
+	void UpdateLocationFromVelocity(FGoKartSimState& State, float DeltaTime)
+	{
+		/**
+		 * dx = v * dt
+		 * Change in location = Velocity * Change in time
+		 *
+		 * Our Velocity is calculated in meters per second (m/s).
+		 * We multiply by 100 because locations are in centimeters.
+		 *
+		 */
+		State.Location += State.Velocity * 100 * DeltaTime;
+
+	}
+
+	template<typename TModel>
+	void SimulateMoveKernel(FGoKartSimState& State, const FGoKartMove& Move, const FGoKartTuning& Tuning, float GravityZ)
+	{
+		const FVector Forward = State.Rotation.GetForwardVector();
+
+		FVector Force = Forward * Tuning.MaxDrivingForce * Move.Throttle;
+
+		Force += GetResistance<TModel>(State.Velocity, Tuning, GravityZ);
+
+		FVector Acceleration = Force / Tuning.Mass;
+
+		State.Velocity = State.Velocity + Acceleration * Move.DeltaTime;
+
+		ApplyRotation<TModel>(State, Forward, Move.DeltaTime, Move.SteeringThrow, Tuning);
+
+		UpdateLocationFromVelocity(State, Move.DeltaTime);
+
+	}
+}
+
+GoKartSimulation::FKernel GoKartSimulation::GetKernel(EGoKartVehicleClass VehicleClass)
+{
+	switch (VehicleClass)
+	{
+	case EGoKartVehicleClass::NoDrag:
+		return &SimulateMoveKernel<FNoDragModel>;
+	case EGoKartVehicleClass::FixedGravity:
+		return &SimulateMoveKernel<FFixedGravityModel>;
+	case EGoKartVehicleClass::Arcade:
+		return &SimulateMoveKernel<FArcadeModel>;
+	default:
+		return &SimulateMoveKernel<FStandardModel>;
+	}
+
+}
+
+FString GoKartInputTrace::GetInputTracePath(const FString& Name)
+{
+	return FPaths::ProjectSavedDir() / TEXT("Trajectories") / (Name + TEXT(".csv"));
+
+}
+
+bool GoKartInputTrace::Save(const FString& Filename, const TArray<FGoKartMove>& Moves)
+{
+	FString Csv = TEXT("DeltaTime,Throttle,SteeringThrow\n");
+	for (const FGoKartMove& Move : Moves)
+	{
+		Csv += FString::Printf(TEXT("%.6f,%.4f,%.4f\n"), Move.DeltaTime, Move.Throttle, Move.SteeringThrow);
+
+	}
+
+	return FFileHelper::SaveStringToFile(Csv, *Filename);
+
+}
+
+bool GoKartInputTrace::Load(const FString& Filename, TArray<FGoKartMove>& OutMoves)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *Filename)) return false;
+
+	OutMoves.Reset(Lines.Num());
+	TArray<FString> Values;
+	for (const FString& Line : Lines)
+	{
+		// Skips the header along with anything else that isn't a move.
+		if (Line.ParseIntoArray(Values, TEXT(",")) != 3 || !Values[0].IsNumeric()) continue;
+
+		FGoKartMove Move;
+		Move.DeltaTime = FCString::Atof(*Values[0]);
+		Move.Throttle = FCString::Atof(*Values[1]);
+		Move.SteeringThrow = FCString::Atof(*Values[2]);
+		if (Move.IsValid())
+		{
+			OutMoves.Add(Move);
+
+		}
+
+	}
+
+	return OutMoves.Num() > 0;
+
+}
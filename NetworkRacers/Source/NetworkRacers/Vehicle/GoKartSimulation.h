@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartMovementInterface.h"
+#include "GoKartSimulation.generated.h"
+
+
+/**
+* Vehicle classes, each a fixed set of modelling choices that GoKartSimulation compiles into its own kernel.
+* See the models in GoKartSimulation.cpp.
+*
+*/
+UENUM(BlueprintType)
+enum class EGoKartVehicleClass : uint8
+{
+	// Full force model: air and rolling resistance under the world's gravity, steering along the turning circle.
+	Standard,
+	// No air resistance, so top speed is only limited by rolling resistance.
+	NoDrag,
+	// Standard, but under the default gravity whatever the world's is.
+	FixedGravity,
+	// Standard forces, but turns at a fixed rate once moving instead of following the turning circle.
+	Arcade,
+};
+
+// Handling parameters of a go-kart, see UGoKartMovementComponent for what each one does.
+struct FGoKartTuning
+{
+	// kg
+	float Mass = 1000.f;
+
+	// N
+	float MaxDrivingForce = 10000.f;
+
+	// m
+	float MinTurningRadius = 10.f;
+
+	float DragCoefficient = 16.f;
+
+	float RollingResistanceCoefficient = 0.015f;
+
+};
+
+// Everything a go-kart's movement depends on besides its tuning and input.
+struct FGoKartSimState
+{
+	// cm
+	FVector Location = FVector::ZeroVector;
+
+	FQuat Rotation = FQuat::Identity;
+
+	// m/s
+	FVector Velocity = FVector::ZeroVector;
+
+};
+
+/**
+* Go-kart movement as a pure function of state, tuning and move, so the same code drives karts in the world and
+* headless runs such as UGoKartTuningCommandlet. It knows nothing about the world: the location it produces hasn't
+* been swept against anything, which is left to the caller.
+*
+*/
+namespace GoKartSimulation
+{
+	// GravityZ as UWorld::GetGravityZ, in cm/s^2 and negative for down.
+	typedef void (*FKernel)(FGoKartSimState& State, const FGoKartMove& Move, const FGoKartTuning& Tuning, float GravityZ);
+
+	// Kernel specialized for a vehicle class. Look it up once per kart rather than per move.
+	NETWORKRACERS_API FKernel GetKernel(EGoKartVehicleClass VehicleClass);
+}
+
+/**
+* A driver's input over a run, as the moves their kart simulated, so it can be replayed with different tuning.
+* Saved as CSV with a header line then one move per line: DeltaTime,Throttle,SteeringThrow
+*
+*/
+namespace GoKartInputTrace
+{
+	// Where input traces are recorded, eg. Saved/Trajectories/<Name>.csv, next to the trajectory of the same run.
+	NETWORKRACERS_API FString GetInputTracePath(const FString& Name);
+
+	NETWORKRACERS_API bool Save(const FString& Filename, const TArray<FGoKartMove>& Moves);
+	NETWORKRACERS_API bool Load(const FString& Filename, TArray<FGoKartMove>& OutMoves);
+}
@@ -0,0 +1,138 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSnapshot.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+
+namespace GoKartSnapshot
+{
+	const uint8 RecordInUse = 1 << 0;
+
+	// Location is stored in mm, velocity in cm/s.
+	const float LocationScale = 10.f;
+	const float VelocityScale = 100.f;
+}
+
+int32 FGoKartSnapshot::AddKart()
+{
+	int32 KartId;
+	if (FreeKartIds.Num() > 0)
+	{
+		KartId = FreeKartIds.Pop(false);
+
+	}
+	else
+	{
+		KartId = NumKarts++;
+		Records.AddZeroed(RecordSize);
+		Chunks.SetNum(GetNumChunks());
+
+	}
+
+	WriteRecord(KartId, GoKartSnapshot::RecordInUse, FGoKartObserverState());
+	return KartId;
+
+}
+
+void FGoKartSnapshot::RemoveKart(int32 KartId)
+{
+	if (KartId < 0 || KartId >= NumKarts) return;
+
+	WriteRecord(KartId, 0, FGoKartObserverState());
+	FreeKartIds.Add(KartId);
+
+}
+
+void FGoKartSnapshot::UpdateKart(int32 KartId, const FGoKartObserverState& State)
+{
+	if (KartId < 0 || KartId >= NumKarts) return;
+
+	WriteRecord(KartId, GoKartSnapshot::RecordInUse, State);
+
+}
+
+void FGoKartSnapshot::WriteRecord(int32 KartId, uint8 Flags, const FGoKartObserverState& State)
+{
+	FMemoryWriter Writer(Records);
+	Writer.Seek(KartId * RecordSize);
+
+	int32 LocationX = FMath::RoundToInt(State.Location.X * GoKartSnapshot::LocationScale);
+	int32 LocationY = FMath::RoundToInt(State.Location.Y * GoKartSnapshot::LocationScale);
+	int32 LocationZ = FMath::RoundToInt(State.Location.Z * GoKartSnapshot::LocationScale);
+	uint16 Pitch = FRotator::CompressAxisToShort(State.Rotation.Pitch);
+	uint16 Yaw = FRotator::CompressAxisToShort(State.Rotation.Yaw);
+	uint16 Roll = FRotator::CompressAxisToShort(State.Rotation.Roll);
+	int16 VelocityX = FMath::Clamp(FMath::RoundToInt(State.Velocity.X * GoKartSnapshot::VelocityScale), (int32)MIN_int16, (int32)MAX_int16);
+	int16 VelocityY = FMath::Clamp(FMath::RoundToInt(State.Velocity.Y * GoKartSnapshot::VelocityScale), (int32)MIN_int16, (int32)MAX_int16);
+	int16 VelocityZ = FMath::Clamp(FMath::RoundToInt(State.Velocity.Z * GoKartSnapshot::VelocityScale), (int32)MIN_int16, (int32)MAX_int16);
+
+	Writer << Flags << LocationX << LocationY << LocationZ << Pitch << Yaw << Roll << VelocityX << VelocityY << VelocityZ;
+
+	Chunks[KartId / KartsPerChunk].bDirty = true;
+
+}
+
+const TArray<uint8>& FGoKartSnapshot::GetCompressedChunk(int32 ChunkIndex)
+{
+	FChunk& Chunk = Chunks[ChunkIndex];
+	if (Chunk.bDirty)
+	{
+		const uint8* Source = Records.GetData() + ChunkIndex * KartsPerChunk * RecordSize;
+		const int32 SourceSize = GetNumKartsInChunk(ChunkIndex) * RecordSize;
+
+		int32 CompressedSize = FCompression::CompressMemoryBound(COMPRESS_ZLIB, SourceSize);
+		Chunk.CompressedData.SetNumUninitialized(CompressedSize);
+		if (FCompression::CompressMemory(COMPRESS_ZLIB, Chunk.CompressedData.GetData(), CompressedSize, Source, SourceSize))
+		{
+			Chunk.CompressedData.SetNum(CompressedSize, false);
+
+		}
+		else
+		{
+			Chunk.CompressedData.Reset();
+
+		}
+		Chunk.bDirty = false;
+
+	}
+
+	return Chunk.CompressedData;
+
+}
+
+bool FGoKartSnapshot::ApplyCompressedChunk(int32 ChunkIndex, int32 NumKartsInChunk, const TArray<uint8>& CompressedData)
+{
+	if (ChunkIndex < 0 || NumKartsInChunk <= 0 || NumKartsInChunk > KartsPerChunk) return false;
+
+	NumKarts = FMath::Max(NumKarts, ChunkIndex * KartsPerChunk + NumKartsInChunk);
+	Records.SetNumZeroed(NumKarts * RecordSize);
+	Chunks.SetNum(GetNumChunks());
+
+	uint8* Destination = Records.GetData() + ChunkIndex * KartsPerChunk * RecordSize;
+	return FCompression::UncompressMemory(COMPRESS_ZLIB, Destination, NumKartsInChunk * RecordSize, CompressedData.GetData(), CompressedData.Num());
+
+}
+
+bool FGoKartSnapshot::GetKart(int32 KartId, FGoKartObserverState& OutState) const
+{
+	if (KartId < 0 || KartId >= NumKarts) return false;
+
+	FMemoryReader Reader(Records);
+	Reader.Seek(KartId * RecordSize);
+
+	uint8 Flags;
+	int32 LocationX, LocationY, LocationZ;
+	uint16 Pitch, Yaw, Roll;
+	int16 VelocityX, VelocityY, VelocityZ;
+	Reader << Flags << LocationX << LocationY << LocationZ << Pitch << Yaw << Roll << VelocityX << VelocityY << VelocityZ;
+
+	if ((Flags & GoKartSnapshot::RecordInUse) == 0) return false;
+
+	OutState.Location = FVector(LocationX, LocationY, LocationZ) / GoKartSnapshot::LocationScale;
+	OutState.Rotation = FRotator(FRotator::DecompressAxisFromShort(Pitch), FRotator::DecompressAxisFromShort(Yaw), FRotator::DecompressAxisFromShort(Roll));
+	OutState.Velocity = FVector(VelocityX, VelocityY, VelocityZ) / GoKartSnapshot::VelocityScale;
+	return true;
+
+}
@@ -0,0 +1,61 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartMovementReplicator.h"
+
+
+/**
+* Compressed snapshot of every kart's observer state, kept up to date on the server for clients that join mid-race.
+*
+* Each kart owns a fixed-size record at KartId * RecordSize, so updating a kart only rewrites its own bytes.
+* Records are grouped into chunks of KartsPerChunk, and a chunk is only recompressed when it has changed since it
+* was last sent, so a joiner costs the same however many karts are racing.
+*
+* On the client the same class holds the chunks received so far.
+*
+*/
+class NETWORKRACERS_API FGoKartSnapshot
+{
+public:
+	// Flags byte, quantized location (3 x int32), rotation (3 x uint16) and velocity (3 x int16).
+	static const int32 RecordSize = 25;
+	static const int32 KartsPerChunk = 32;
+
+	// Server: claim a record for a kart. Returns its KartId.
+	int32 AddKart();
+	void RemoveKart(int32 KartId);
+	void UpdateKart(int32 KartId, const FGoKartObserverState& State);
+
+	// Number of records, including free ones. Every KartId is lower than this.
+	int32 GetNumKarts() const { return NumKarts; };
+	int32 GetNumChunks() const { return FMath::DivideAndRoundUp(NumKarts, KartsPerChunk); };
+	int32 GetNumKartsInChunk(int32 ChunkIndex) const { return FMath::Clamp(NumKarts - ChunkIndex * KartsPerChunk, 0, KartsPerChunk); };
+
+	// Server: the chunk's records, zlib compressed. Recompressed only if a kart in it has changed.
+	const TArray<uint8>& GetCompressedChunk(int32 ChunkIndex);
+
+	// Client: store a chunk received from the server.
+	bool ApplyCompressedChunk(int32 ChunkIndex, int32 NumKartsInChunk, const TArray<uint8>& CompressedData);
+
+	// Client: state of a kart from the snapshot, if its record has been received and is in use.
+	bool GetKart(int32 KartId, FGoKartObserverState& OutState) const;
+
+private:
+	void WriteRecord(int32 KartId, uint8 Flags, const FGoKartObserverState& State);
+
+	struct FChunk
+	{
+		TArray<uint8> CompressedData;
+		bool bDirty = true;
+	};
+
+	TArray<uint8> Records;
+	TArray<FChunk> Chunks;
+	int32 NumKarts = 0;
+
+	// Records released by karts that have left, reused before growing.
+	TArray<int32> FreeKartIds;
+
+};
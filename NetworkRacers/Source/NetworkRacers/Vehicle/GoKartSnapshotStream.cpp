@@ -0,0 +1,218 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSnapshotStream.h"
+#include "GoKartGhost.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+
+
+AGoKartSnapshotStream::AGoKartSnapshotStream()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	bReplicates = true;
+	bOnlyRelevantToOwner = true;
+	bAlwaysRelevant = false;
+
+	StandInClass = AGoKartGhost::StaticClass();
+
+	Snapshot = nullptr;
+	NextChunk = 0;
+	NumKartsAdmitted = 0;
+	StandInTimeLeft = -1.f;
+
+}
+
+void AGoKartSnapshotStream::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (Role == ROLE_Authority) return;
+
+	// Karts that replicated before we did don't need stand-ins.
+	for (TActorIterator<APawn> It(GetWorld()); It; ++It)
+	{
+		const UGoKartMovementReplicator* Replicator = It->FindComponentByClass<UGoKartMovementReplicator>();
+		if (Replicator != nullptr && Replicator->GetKartId() != INDEX_NONE)
+		{
+			ArrivedKartIds.Add(Replicator->GetKartId());
+
+		}
+
+	}
+
+}
+
+void AGoKartSnapshotStream::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	DestroyStandIns();
+
+	Super::EndPlay(EndPlayReason);
+
+}
+
+void AGoKartSnapshotStream::StartStreaming(FGoKartSnapshot* InSnapshot)
+{
+	Snapshot = InSnapshot;
+	NextChunk = 0;
+	NumKartsAdmitted = 0;
+	SetActorTickEnabled(Snapshot != nullptr);
+
+}
+
+void AGoKartSnapshotStream::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Role == ROLE_Authority)
+	{
+		ServerTick();
+
+	}
+	else
+	{
+		ClientTick(DeltaTime);
+
+	}
+
+}
+
+void AGoKartSnapshotStream::ServerTick()
+{
+	if (Snapshot == nullptr) return;
+
+	/**
+	* Chunks are compressed when first sent after a change, and karts keep moving while we stream, so later chunks
+	* are fresher than earlier ones. That's fine: each kart's own replication takes over once it is admitted.
+	*
+	*/
+	const int32 NumChunks = Snapshot->GetNumChunks();
+	for (int32 Sent = 0; Sent < ChunksPerTick && NextChunk < NumChunks; ++Sent, ++NextChunk)
+	{
+		Client_ReceiveChunk(NextChunk, Snapshot->GetNumKartsInChunk(NextChunk), Snapshot->GetCompressedChunk(NextChunk));
+
+	}
+
+	NumKartsAdmitted = FMath::Min(NumKartsAdmitted + KartsAdmittedPerTick, Snapshot->GetNumKarts());
+
+	if (NextChunk >= NumChunks && NumKartsAdmitted >= Snapshot->GetNumKarts())
+	{
+		Client_StreamComplete();
+
+		// Karts that join after this are admitted straight away.
+		NumKartsAdmitted = MAX_int32;
+		SetActorTickEnabled(false);
+
+	}
+
+}
+
+void AGoKartSnapshotStream::ClientTick(float DeltaTime)
+{
+	// Stand-ins only live until their kart arrives, so carrying them on in a straight line is close enough.
+	for (const TPair<int32, FStandIn>& Pair : StandIns)
+	{
+		if (AActor* StandIn = Pair.Value.Actor.Get())
+		{
+			StandIn->AddActorWorldOffset(Pair.Value.Velocity * DeltaTime);
+
+		}
+
+	}
+
+	if (StandInTimeLeft >= 0.f)
+	{
+		StandInTimeLeft -= DeltaTime;
+		if (StandInTimeLeft < 0.f)
+		{
+			DestroyStandIns();
+
+		}
+
+	}
+
+	if (StandIns.Num() == 0)
+	{
+		SetActorTickEnabled(false);
+
+	}
+
+}
+
+void AGoKartSnapshotStream::OnKartArrived(int32 KartId)
+{
+	if (KartId == INDEX_NONE) return;
+
+	ArrivedKartIds.Add(KartId);
+
+	FStandIn StandIn;
+	if (StandIns.RemoveAndCopyValue(KartId, StandIn) && StandIn.Actor.IsValid())
+	{
+		StandIn.Actor->Destroy();
+
+	}
+
+}
+
+void AGoKartSnapshotStream::DestroyStandIns()
+{
+	for (const TPair<int32, FStandIn>& Pair : StandIns)
+	{
+		if (AActor* StandIn = Pair.Value.Actor.Get())
+		{
+			StandIn->Destroy();
+
+		}
+
+	}
+	StandIns.Reset();
+
+}
+
+void AGoKartSnapshotStream::Client_ReceiveChunk_Implementation(int32 ChunkIndex, int32 NumKartsInChunk, const TArray<uint8>& CompressedData)
+{
+	if (!ClientSnapshot.ApplyCompressedChunk(ChunkIndex, NumKartsInChunk, CompressedData))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Couldn't decompress kart snapshot chunk %d."), ChunkIndex);
+		return;
+
+	}
+
+	if (StandInClass == nullptr) return;
+
+	const int32 FirstKartId = ChunkIndex * FGoKartSnapshot::KartsPerChunk;
+	for (int32 KartId = FirstKartId; KartId < FirstKartId + NumKartsInChunk; ++KartId)
+	{
+		FGoKartObserverState State;
+		if (ArrivedKartIds.Contains(KartId) || StandIns.Contains(KartId) || !ClientSnapshot.GetKart(KartId, State)) continue;
+
+		FActorSpawnParameters SpawnInfo;
+		SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		if (AActor* StandIn = GetWorld()->SpawnActor<AActor>(StandInClass, State.Location, State.Rotation, SpawnInfo))
+		{
+			FStandIn& Entry = StandIns.Add(KartId);
+			Entry.Actor = StandIn;
+
+			// The snapshot has velocity in m/s.
+			Entry.Velocity = State.Velocity * 100.f;
+
+		}
+
+	}
+
+	if (StandIns.Num() > 0)
+	{
+		SetActorTickEnabled(true);
+
+	}
+
+}
+
+void AGoKartSnapshotStream::Client_StreamComplete_Implementation()
+{
+	// Every kart has been admitted, so the rest of the stand-ins' karts arrive shortly, if they are still racing.
+	StandInTimeLeft = StandInLifetime;
+
+}
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Info.h"
+#include "GoKartSnapshot.h"
+#include "GoKartSnapshotStream.generated.h"
+
+
+/**
+* Brings a client that joined mid-race up to date with every kart, spread over several frames.
+*
+* Spawned by the game mode for each joining player and only relevant to them. It sends the cached kart snapshot a few
+* chunks per tick, and admits karts to the joiner a few per tick so their actor channels (and full initial property
+* replication) don't all open in the same server frame. Until a kart's actor arrives, the client shows a stand-in for it
+* where the snapshot has it, carried along at the kart's snapshot velocity.
+*
+*/
+UCLASS(NotPlaceable, Transient)
+class NETWORKRACERS_API AGoKartSnapshotStream : public AInfo
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartSnapshotStream();
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	virtual void Tick(float DeltaTime) override;
+
+	// Server: start streaming the given snapshot, which must outlive this actor.
+	void StartStreaming(FGoKartSnapshot* InSnapshot);
+
+	// Server: whether the kart's actor may be replicated to the joiner yet.
+	bool IsKartAdmitted(int32 KartId) const { return KartId < NumKartsAdmitted; };
+
+	// Client: the kart's actor has replicated, so its stand-in is no longer needed. See UGoKartMovementReplicator::KartId.
+	void OnKartArrived(int32 KartId);
+
+protected:
+	// Snapshot chunks sent to the joiner per tick.
+	UPROPERTY(EditDefaultsOnly, Category = "Snapshot")
+	int32 ChunksPerTick = 1;
+
+	// Karts whose actors start replicating to the joiner per tick.
+	UPROPERTY(EditDefaultsOnly, Category = "Snapshot")
+	int32 KartsAdmittedPerTick = 4;
+
+	// Spawned on the client in place of karts whose actors haven't arrived yet.
+	UPROPERTY(EditDefaultsOnly, Category = "Snapshot")
+	TSubclassOf<AActor> StandInClass;
+
+	// How long stand-ins are kept after the last chunk (s). Karts that left the race mid-stream never arrive.
+	UPROPERTY(EditDefaultsOnly, Category = "Snapshot")
+	float StandInLifetime = 2.f;
+
+private:
+	UFUNCTION(Client, Reliable)
+	void Client_ReceiveChunk(int32 ChunkIndex, int32 NumKartsInChunk, const TArray<uint8>& CompressedData);
+
+	UFUNCTION(Client, Reliable)
+	void Client_StreamComplete();
+
+	FGoKartSnapshot* Snapshot;
+
+	int32 NextChunk;
+	int32 NumKartsAdmitted;
+
+	void ServerTick();
+
+	void ClientTick(float DeltaTime);
+
+	void DestroyStandIns();
+
+	FGoKartSnapshot ClientSnapshot;
+
+	struct FStandIn
+	{
+		TWeakObjectPtr<AActor> Actor;
+
+		// cm/s
+		FVector Velocity;
+	};
+
+	TMap<int32, FStandIn> StandIns;
+
+	// Karts whose actors the client already has.
+	TSet<int32> ArrivedKartIds;
+
+	// Time left before the remaining stand-ins are removed, negative until the stream is complete.
+	float StandInTimeLeft;
+
+};
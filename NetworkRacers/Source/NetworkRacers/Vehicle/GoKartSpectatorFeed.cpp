@@ -0,0 +1,212 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSpectatorFeed.h"
+#include "GoKartSpectatorStream.h"
+#include "GoKartClockSync.h"
+#include "GoKartGhost.h"
+#include "Engine/World.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+
+
+AGoKartSpectatorFeed::AGoKartSpectatorFeed()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	KartClass = AGoKartGhost::StaticClass();
+
+	Socket = nullptr;
+	TimeSinceHello = 0.f;
+
+}
+
+bool AGoKartSpectatorFeed::Connect(const FString& RelayAddress)
+{
+	GoKartSpectator::DestroySocket(Socket);
+
+	if (KartClass == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s has no KartClass, so there is nothing to show the spectated karts with."), *GetName());
+		return false;
+
+	}
+
+	Relay = GoKartSpectator::ParseAddress(RelayAddress);
+	if (!Relay.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Bad spectator relay address %s, expected host:port."), *RelayAddress);
+		return false;
+
+	}
+
+	Socket = GoKartSpectator::CreateSocket(TEXT("GoKartSpectatorFeed"), 0);
+	if (Socket == nullptr) return false;
+
+	Cookie.Reset();
+	Cookie.SetNumZeroed(GoKartSpectator::CookieSize);
+
+	SendHello();
+	SetActorTickEnabled(true);
+	return true;
+
+}
+
+void AGoKartSpectatorFeed::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GoKartSpectator::DestroySocket(Socket);
+
+	Super::EndPlay(EndPlayReason);
+
+}
+
+void AGoKartSpectatorFeed::SendHello()
+{
+	GoKartSpectator::FDatagramHeader Header;
+	Header.Type = GoKartSpectator::EDatagramType::Hello;
+
+	TArray<uint8> Datagram;
+	GoKartSpectator::WriteDatagram(Datagram, Header, Cookie);
+
+	int32 BytesSent = 0;
+	Socket->SendTo(Datagram.GetData(), Datagram.Num(), BytesSent, *Relay);
+	TimeSinceHello = 0.f;
+
+}
+
+void AGoKartSpectatorFeed::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Socket == nullptr) return;
+
+	TimeSinceHello += DeltaTime;
+	if (TimeSinceHello >= GoKartSpectator::HelloInterval)
+	{
+		SendHello();
+
+	}
+
+	ReceiveDatagrams();
+
+	// Follow the same spline as UGoKartMovementReplicator::ClientTick, but stop at the target rather than overshoot.
+	for (int32 KartId = 0; KartId < Karts.Num(); ++KartId)
+	{
+		FSpectatedKart& Kart = Karts[KartId];
+		AActor* KartActor = KartActors[KartId];
+		if (KartActor == nullptr || Kart.TimeBetweenUpdates < KINDA_SMALL_NUMBER) continue;
+
+		Kart.TimeSinceUpdate += DeltaTime;
+		const float LerpRatio = FMath::Min(Kart.TimeSinceUpdate / Kart.TimeBetweenUpdates, 1.f);
+		const float VelocityToDerivative = Kart.TimeBetweenUpdates * 100;
+
+		FHermiteCubicSpline Spline;
+		Spline.StartLocation = Kart.Start.Location;
+		Spline.StartDerivative = Kart.Start.Velocity * VelocityToDerivative;
+		Spline.TargetLocation = Kart.Target.Location;
+		Spline.TargetDerivative = Kart.Target.Velocity * VelocityToDerivative;
+
+		const FQuat Rotation = FQuat::Slerp(Kart.Start.Rotation.Quaternion(), Kart.Target.Rotation.Quaternion(), LerpRatio);
+		KartActor->SetActorLocationAndRotation(Spline.InterpolateLocation(LerpRatio), Rotation);
+
+	}
+
+}
+
+void AGoKartSpectatorFeed::ReceiveDatagrams()
+{
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> Sender = SocketSubsystem->CreateInternetAddr();
+	uint8 Buffer[GoKartSpectator::MaxDatagramSize];
+	GoKartSpectator::FDatagramHeader Header;
+
+	int32 BytesRead = 0;
+	while (Socket->RecvFrom(Buffer, sizeof(Buffer), BytesRead, *Sender))
+	{
+		if (!GoKartSpectator::ReadDatagram(Buffer, BytesRead, Header, Payload)) continue;
+
+		// The relay only streams to us once we have echoed a cookie, so answer straight away.
+		if (Header.Type == GoKartSpectator::EDatagramType::Cookie)
+		{
+			if (*Sender == *Relay && Payload.Num() == GoKartSpectator::CookieSize)
+			{
+				Cookie = Payload;
+				SendHello();
+
+			}
+			continue;
+
+		}
+		if (Header.Type != GoKartSpectator::EDatagramType::Chunk) continue;
+
+		// UDP can reorder, so only take a chunk newer than the last one we applied.
+		if (ChunkServerTicks.IsValidIndex(Header.ChunkIndex) && Header.ServerTicks <= ChunkServerTicks[Header.ChunkIndex]) continue;
+		if (!Snapshot.ApplyCompressedChunk(Header.ChunkIndex, Header.NumKartsInChunk, Payload)) continue;
+
+		if (ChunkServerTicks.Num() <= Header.ChunkIndex)
+		{
+			ChunkServerTicks.SetNumZeroed(Header.ChunkIndex + 1);
+
+		}
+		const int64 PrevServerTicks = ChunkServerTicks[Header.ChunkIndex];
+		ChunkServerTicks[Header.ChunkIndex] = Header.ServerTicks;
+		const float TimeBetweenUpdates = PrevServerTicks > 0 ? GoKartTime::TicksToSeconds(Header.ServerTicks - PrevServerTicks) : 0.f;
+
+		const int32 FirstKartId = Header.ChunkIndex * FGoKartSnapshot::KartsPerChunk;
+		for (int32 KartId = FirstKartId; KartId < FirstKartId + Header.NumKartsInChunk; ++KartId)
+		{
+			FGoKartObserverState State;
+			if (Snapshot.GetKart(KartId, State))
+			{
+				OnKartUpdated(KartId, State, TimeBetweenUpdates);
+
+			}
+			else if (KartActors.IsValidIndex(KartId) && KartActors[KartId] != nullptr)
+			{
+				// The kart has left the race.
+				KartActors[KartId]->Destroy();
+				KartActors[KartId] = nullptr;
+				Karts[KartId] = FSpectatedKart();
+
+			}
+
+		}
+
+	}
+
+}
+
+void AGoKartSpectatorFeed::OnKartUpdated(int32 KartId, const FGoKartObserverState& State, float TimeBetweenUpdates)
+{
+	if (Karts.Num() <= KartId)
+	{
+		Karts.SetNum(KartId + 1);
+		KartActors.SetNumZeroed(KartId + 1);
+
+	}
+
+	FSpectatedKart& Kart = Karts[KartId];
+	AActor*& KartActor = KartActors[KartId];
+	if (KartActor == nullptr)
+	{
+		FActorSpawnParameters SpawnInfo;
+		SpawnInfo.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		KartActor = GetWorld()->SpawnActor<AActor>(KartClass, State.Location, State.Rotation, SpawnInfo);
+		Kart.Start = State;
+
+	}
+	else
+	{
+		// Start from where the stand-in is now, so a late frame doesn't make it jump.
+		Kart.Start.Location = KartActor->GetActorLocation();
+		Kart.Start.Rotation = KartActor->GetActorRotation();
+		Kart.Start.Velocity = Kart.Target.Velocity;
+
+	}
+
+	Kart.Target = State;
+	Kart.TimeSinceUpdate = 0.f;
+	Kart.TimeBetweenUpdates = TimeBetweenUpdates;
+
+}
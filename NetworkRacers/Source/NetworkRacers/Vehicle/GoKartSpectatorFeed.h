@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GoKartSnapshot.h"
+#include "GoKartSpectatorFeed.generated.h"
+
+class FSocket;
+class FInternetAddr;
+
+
+/**
+* Spectator end of the spectator stream. Receives kart snapshots from a relay (see UGoKartSpectatorRelayCommandlet)
+* and moves a local stand-in actor per kart, interpolating between frames as UGoKartMovementReplicator does for
+* simulated proxies. Nothing here talks to the race server.
+*
+*/
+UCLASS(NotPlaceable, Transient)
+class NETWORKRACERS_API AGoKartSpectatorFeed : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AGoKartSpectatorFeed();
+
+	virtual void Tick(float DeltaTime) override;
+
+	// Start watching the stream from the relay at "host:port".
+	bool Connect(const FString& RelayAddress);
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Spawned locally to stand in for each kart. Required; defaults to AGoKartGhost, which shows the kart mesh.
+	UPROPERTY(EditAnywhere, Category = "Spectator")
+	TSubclassOf<AActor> KartClass;
+
+private:
+	void ReceiveDatagrams();
+
+	void OnKartUpdated(int32 KartId, const FGoKartObserverState& State, float TimeBetweenUpdates);
+
+	void SendHello();
+
+	struct FSpectatedKart
+	{
+		FGoKartObserverState Start;
+		FGoKartObserverState Target;
+		float TimeSinceUpdate = 0.f;
+		float TimeBetweenUpdates = 0.f;
+	};
+
+	// Indexed by KartId, as are KartActors.
+	TArray<FSpectatedKart> Karts;
+
+	UPROPERTY(Transient)
+	TArray<AActor*> KartActors;
+
+	FGoKartSnapshot Snapshot;
+
+	FSocket* Socket;
+	TSharedPtr<FInternetAddr> Relay;
+	float TimeSinceHello;
+
+	// Last cookie the relay gave us, echoed in every hello.
+	TArray<uint8> Cookie;
+
+	// Server time of the newest frame received per chunk, to space out interpolation (GoKartTime ticks).
+	TArray<int64> ChunkServerTicks;
+
+	TArray<uint8> Payload;
+
+};
@@ -0,0 +1,208 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSpectatorRelayCommandlet.h"
+#include "GoKartSpectatorStream.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/CoreMisc.h"
+#include "Misc/Guid.h"
+#include "Misc/Parse.h"
+#include "Misc/SecureHash.h"
+
+
+namespace GoKartSpectatorRelay
+{
+	// Cookie for Address during the CookieLifetime period Epoch. Only a relay that knows Secret can make it.
+	TArray<uint8> MakeCookie(const FGuid& Secret, const FInternetAddr& Address, int64 Epoch)
+	{
+		uint32 Ip = 0;
+		Address.GetIp(Ip);
+		const int32 Port = Address.GetPort();
+
+		FSHA1 Sha;
+		Sha.Update(reinterpret_cast<const uint8*>(&Secret), sizeof(Secret));
+		Sha.Update(reinterpret_cast<const uint8*>(&Ip), sizeof(Ip));
+		Sha.Update(reinterpret_cast<const uint8*>(&Port), sizeof(Port));
+		Sha.Update(reinterpret_cast<const uint8*>(&Epoch), sizeof(Epoch));
+		Sha.Final();
+
+		uint8 Hash[20];
+		Sha.GetHash(Hash);
+		return TArray<uint8>(Hash, GoKartSpectator::CookieSize);
+
+	}
+}
+
+UGoKartSpectatorRelayCommandlet::UGoKartSpectatorRelayCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+
+}
+
+int32 UGoKartSpectatorRelayCommandlet::Main(const FString& Params)
+{
+	int32 UpstreamPort = 7788;
+	int32 SpectatorPort = 7789;
+	int32 MaxSpectatorsPerAddress = 4;
+	int32 MaxHellosPerSecond = 100;
+	FString ServerHost;
+	FParse::Value(*Params, TEXT("UpstreamPort="), UpstreamPort);
+	FParse::Value(*Params, TEXT("SpectatorPort="), SpectatorPort);
+	FParse::Value(*Params, TEXT("MaxSpectatorsPerAddress="), MaxSpectatorsPerAddress);
+	FParse::Value(*Params, TEXT("MaxHellosPerSecond="), MaxHellosPerSecond);
+	FParse::Value(*Params, TEXT("Server="), ServerHost);
+
+	// Only the host matters: the race server sends from whichever port it was given.
+	TSharedPtr<FInternetAddr> Server = ServerHost.IsEmpty() ? nullptr : GoKartSpectator::ParseAddress(FString::Printf(TEXT("%s:%d"), *ServerHost, UpstreamPort));
+	if (!Server.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Spectator relay needs the race server's host, eg. -Server=127.0.0.1, to take the stream from."));
+		return 1;
+
+	}
+	uint32 ServerIp = 0;
+	Server->GetIp(ServerIp);
+
+	FSocket* UpstreamSocket = GoKartSpectator::CreateSocket(TEXT("GoKartSpectatorRelayUpstream"), UpstreamPort);
+	FSocket* SpectatorSocket = GoKartSpectator::CreateSocket(TEXT("GoKartSpectatorRelaySpectators"), SpectatorPort);
+	if (UpstreamSocket == nullptr || SpectatorSocket == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't open spectator relay ports %d and %d."), UpstreamPort, SpectatorPort);
+		GoKartSpectator::DestroySocket(UpstreamSocket);
+		GoKartSpectator::DestroySocket(SpectatorSocket);
+		return 1;
+
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Spectator relay: race server %s -> %d, spectators -> %d."), *ServerHost, UpstreamPort, SpectatorPort);
+
+	struct FSpectator
+	{
+		TSharedRef<FInternetAddr> Address;
+		double LastHelloTime;
+	};
+	TArray<FSpectator> Spectators;
+
+	ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+	TSharedRef<FInternetAddr> Sender = SocketSubsystem->CreateInternetAddr();
+	uint8 Buffer[GoKartSpectator::MaxDatagramSize];
+	GoKartSpectator::FDatagramHeader Header;
+	TArray<uint8> Payload;
+	TArray<uint8> Datagram;
+
+	// Cookies are keyed with a secret made afresh each run.
+	const FGuid Secret = FGuid::NewGuid();
+
+	// Cookies we may still send this second, topped up at MaxHellosPerSecond.
+	double CookieBudget = MaxHellosPerSecond;
+
+	uint64 DatagramsForwarded = 0;
+	double LastReportTime = FPlatformTime::Seconds();
+	double LastLoopTime = LastReportTime;
+
+	while (!GIsRequestingExit)
+	{
+		const double Now = FPlatformTime::Seconds();
+		bool bIdle = true;
+
+		CookieBudget = FMath::Min(CookieBudget + (Now - LastLoopTime) * MaxHellosPerSecond, (double)MaxHellosPerSecond);
+		LastLoopTime = Now;
+
+		// Spectators announcing themselves.
+		int32 BytesRead = 0;
+		while (SpectatorSocket->RecvFrom(Buffer, sizeof(Buffer), BytesRead, *Sender))
+		{
+			bIdle = false;
+			if (!GoKartSpectator::ReadDatagram(Buffer, BytesRead, Header, Payload) || Header.Type != GoKartSpectator::EDatagramType::Hello) continue;
+			if (Payload.Num() != GoKartSpectator::CookieSize) continue;
+
+			// Cookies from this period or the last are good, so one is valid for at least CookieLifetime.
+			const int64 Epoch = static_cast<int64>(Now / GoKartSpectator::CookieLifetime);
+			const bool bValidCookie = Payload == GoKartSpectatorRelay::MakeCookie(Secret, *Sender, Epoch)
+				|| Payload == GoKartSpectatorRelay::MakeCookie(Secret, *Sender, Epoch - 1);
+			if (!bValidCookie)
+			{
+				if (CookieBudget < 1.0) continue;
+				CookieBudget -= 1.0;
+
+				GoKartSpectator::FDatagramHeader CookieHeader;
+				CookieHeader.Type = GoKartSpectator::EDatagramType::Cookie;
+				GoKartSpectator::WriteDatagram(Datagram, CookieHeader, GoKartSpectatorRelay::MakeCookie(Secret, *Sender, Epoch));
+
+				int32 BytesSent = 0;
+				SpectatorSocket->SendTo(Datagram.GetData(), Datagram.Num(), BytesSent, *Sender);
+				continue;
+
+			}
+
+			FSpectator* Existing = Spectators.FindByPredicate([&Sender](const FSpectator& Spectator) { return *Spectator.Address == *Sender; });
+			if (Existing != nullptr)
+			{
+				Existing->LastHelloTime = Now;
+				continue;
+
+			}
+
+			uint32 SenderIp = 0;
+			Sender->GetIp(SenderIp);
+			const int32 NumFromAddress = Spectators.FilterByPredicate([SenderIp](const FSpectator& Spectator)
+			{
+				uint32 Ip = 0;
+				Spectator.Address->GetIp(Ip);
+				return Ip == SenderIp;
+			}).Num();
+			if (NumFromAddress >= MaxSpectatorsPerAddress) continue;
+
+			TSharedRef<FInternetAddr> Address = SocketSubsystem->CreateInternetAddr(SenderIp, Sender->GetPort());
+			Spectators.Add({ Address, Now });
+			UE_LOG(LogTemp, Display, TEXT("Spectator joined: %s (%d watching)."), *Sender->ToString(true), Spectators.Num());
+
+		}
+
+		Spectators.RemoveAllSwap([Now](const FSpectator& Spectator) { return Now - Spectator.LastHelloTime > GoKartSpectator::SpectatorTimeout; });
+
+		// Frames from the race server, forwarded as they are.
+		while (UpstreamSocket->RecvFrom(Buffer, sizeof(Buffer), BytesRead, *Sender))
+		{
+			bIdle = false;
+
+			uint32 SenderIp = 0;
+			Sender->GetIp(SenderIp);
+			if (SenderIp != ServerIp || !GoKartSpectator::ReadDatagram(Buffer, BytesRead, Header, Payload) || Header.Type != GoKartSpectator::EDatagramType::Chunk) continue;
+
+			for (const FSpectator& Spectator : Spectators)
+			{
+				int32 BytesSent = 0;
+				SpectatorSocket->SendTo(Buffer, BytesRead, BytesSent, *Spectator.Address);
+
+			}
+			DatagramsForwarded += Spectators.Num();
+
+		}
+
+		if (Now - LastReportTime >= 10.0)
+		{
+			UE_LOG(LogTemp, Display, TEXT("Spectator relay: %d spectators, %llu datagrams forwarded."), Spectators.Num(), DatagramsForwarded);
+			LastReportTime = Now;
+
+		}
+
+		if (bIdle)
+		{
+			FPlatformProcess::Sleep(0.001f);
+
+		}
+
+	}
+
+	GoKartSpectator::DestroySocket(UpstreamSocket);
+	GoKartSpectator::DestroySocket(SpectatorSocket);
+	return 0;
+
+}
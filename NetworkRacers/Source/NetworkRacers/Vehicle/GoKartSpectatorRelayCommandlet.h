@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GoKartSpectatorRelayCommandlet.generated.h"
+
+
+/**
+* Spectator relay, run as its own process next to (or far from) the race server:
+*
+*	UE4Editor-Cmd NetworkRacers -run=GoKartSpectatorRelay -Server=<race server host> -UpstreamPort=7788 -SpectatorPort=7789
+*		[-MaxSpectatorsPerAddress=4] [-MaxHellosPerSecond=100]
+*
+* Receives the spectator stream from the race server on UpstreamPort and forwards every datagram, untouched, to each
+* spectator that has said hello on SpectatorPort within GoKartSpectator::SpectatorTimeout. The relay never decodes
+* frames, so one relay can serve many spectators.
+*
+* A relay that streamed to whoever asked could be pointed at anyone, so:
+*	- Datagrams on UpstreamPort are only taken from the Server host.
+*	- A hello only counts if it echoes a cookie the relay sent to the hello's address, which proves the address
+*	  receives what is sent to it. Cookies are a keyed hash of the address and the time, so the relay keeps no state
+*	  for hellos it answers. Answers are no larger than the hello, and at most MaxHellosPerSecond are sent.
+*	- At most MaxSpectatorsPerAddress spectators are streamed to per IP address.
+*
+* Everything happens over UDP, so it can be tried out on one machine over loopback.
+*
+*/
+UCLASS()
+class UGoKartSpectatorRelayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGoKartSpectatorRelayCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+};
@@ -0,0 +1,156 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartSpectatorStream.h"
+#include "GoKartSnapshot.h"
+#include "Sockets.h"
+#include "SocketSubsystem.h"
+#include "IPAddress.h"
+#include "Common/UdpSocketBuilder.h"
+#include "Interfaces/IPv4/IPv4Endpoint.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+
+namespace GoKartSpectator
+{
+	void WriteDatagram(TArray<uint8>& OutDatagram, const FDatagramHeader& Header, const TArray<uint8>& Payload)
+	{
+		OutDatagram.Reset();
+		FMemoryWriter Writer(OutDatagram);
+
+		uint32 DatagramMagic = Magic;
+		uint8 Type = static_cast<uint8>(Header.Type);
+		uint32 Frame = Header.Frame;
+		int64 ServerTicks = Header.ServerTicks;
+		uint16 ChunkIndex = Header.ChunkIndex;
+		uint16 NumKartsInChunk = Header.NumKartsInChunk;
+		Writer << DatagramMagic << Type << Frame << ServerTicks << ChunkIndex << NumKartsInChunk;
+
+		OutDatagram.Append(Payload);
+
+	}
+
+	bool ReadDatagram(const uint8* Data, int32 Size, FDatagramHeader& OutHeader, TArray<uint8>& OutPayload)
+	{
+		const int32 HeaderSize = sizeof(uint32) + sizeof(uint8) + sizeof(uint32) + sizeof(int64) + sizeof(uint16) + sizeof(uint16);
+		if (Size < HeaderSize) return false;
+
+		TArray<uint8> HeaderBytes(Data, HeaderSize);
+		FMemoryReader Reader(HeaderBytes);
+
+		uint32 DatagramMagic;
+		uint8 Type;
+		Reader << DatagramMagic << Type << OutHeader.Frame << OutHeader.ServerTicks << OutHeader.ChunkIndex << OutHeader.NumKartsInChunk;
+		if (DatagramMagic != Magic || Type > static_cast<uint8>(EDatagramType::Cookie)) return false;
+
+		OutHeader.Type = static_cast<EDatagramType>(Type);
+		OutPayload.Reset();
+		OutPayload.Append(Data + HeaderSize, Size - HeaderSize);
+		return true;
+
+	}
+
+	FSocket* CreateSocket(const FString& Description, int32 Port)
+	{
+		return FUdpSocketBuilder(Description)
+			.AsNonBlocking()
+			.AsReusable()
+			.BoundToAddress(FIPv4Address::Any)
+			.BoundToPort(Port)
+			.WithReceiveBufferSize(256 * 1024)
+			.WithSendBufferSize(256 * 1024);
+
+	}
+
+	void DestroySocket(FSocket*& Socket)
+	{
+		if (Socket == nullptr) return;
+
+		Socket->Close();
+		ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM)->DestroySocket(Socket);
+		Socket = nullptr;
+
+	}
+
+	TSharedPtr<FInternetAddr> ParseAddress(const FString& Address)
+	{
+		FIPv4Endpoint Endpoint;
+		if (FIPv4Endpoint::Parse(Address, Endpoint)) return Endpoint.ToInternetAddr();
+
+		// Not an IP, so look the host up. This blocks, but only runs when a stream is started.
+		FString Host;
+		FString PortString;
+		if (!Address.Split(TEXT(":"), &Host, &PortString, ESearchCase::IgnoreCase, ESearchDir::FromEnd) || Host.IsEmpty() || !PortString.IsNumeric()) return nullptr;
+
+		const int32 Port = FCString::Atoi(*PortString);
+		if (Port <= 0 || Port > MAX_uint16) return nullptr;
+
+		ISocketSubsystem* SocketSubsystem = ISocketSubsystem::Get(PLATFORM_SOCKETSUBSYSTEM);
+		TSharedRef<FInternetAddr> Addr = SocketSubsystem->CreateInternetAddr();
+		if (SocketSubsystem->GetHostByName(TCHAR_TO_ANSI(*Host), *Addr) != SE_NO_ERROR) return nullptr;
+
+		Addr->SetPort(Port);
+		return Addr;
+
+	}
+}
+
+FGoKartSpectatorBroadcaster::FGoKartSpectatorBroadcaster()
+	: Socket(nullptr)
+	, NextFrame(0)
+{
+
+}
+
+FGoKartSpectatorBroadcaster::~FGoKartSpectatorBroadcaster()
+{
+	Stop();
+
+}
+
+bool FGoKartSpectatorBroadcaster::Start(const FString& RelayAddress)
+{
+	Stop();
+
+	Relay = GoKartSpectator::ParseAddress(RelayAddress);
+	if (!Relay.IsValid())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("Bad spectator relay address %s, expected host:port."), *RelayAddress);
+		return false;
+
+	}
+
+	Socket = GoKartSpectator::CreateSocket(TEXT("GoKartSpectatorBroadcast"), 0);
+	return Socket != nullptr;
+
+}
+
+void FGoKartSpectatorBroadcaster::Stop()
+{
+	GoKartSpectator::DestroySocket(Socket);
+	Relay.Reset();
+
+}
+
+void FGoKartSpectatorBroadcaster::Broadcast(FGoKartSnapshot& Snapshot, int64 ServerTicks)
+{
+	if (Socket == nullptr) return;
+
+	GoKartSpectator::FDatagramHeader Header;
+	Header.Type = GoKartSpectator::EDatagramType::Chunk;
+	Header.Frame = NextFrame++;
+	Header.ServerTicks = ServerTicks;
+
+	// The snapshot only recompresses chunks that changed, and each is sent once however many spectators there are.
+	for (int32 ChunkIndex = 0; ChunkIndex < Snapshot.GetNumChunks(); ++ChunkIndex)
+	{
+		Header.ChunkIndex = ChunkIndex;
+		Header.NumKartsInChunk = Snapshot.GetNumKartsInChunk(ChunkIndex);
+		GoKartSpectator::WriteDatagram(Datagram, Header, Snapshot.GetCompressedChunk(ChunkIndex));
+
+		int32 BytesSent = 0;
+		Socket->SendTo(Datagram.GetData(), Datagram.Num(), BytesSent, *Relay);
+
+	}
+
+}
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FSocket;
+class FInternetAddr;
+class FGoKartSnapshot;
+
+
+/**
+* Spectator stream: the race server's kart snapshot sent as UDP datagrams, one per snapshot chunk, to a relay
+* (see UGoKartSpectatorRelayCommandlet) that fans it out to any number of spectators (see AGoKartSpectatorFeed).
+*
+* The server builds each frame once for every spectator, so spectators cost it nothing beyond the single stream.
+* Frames are self-contained, so a lost datagram only delays the karts in that chunk until the next frame.
+*
+* Datagram: header { uint32 Magic, uint8 Type, uint32 Frame, int64 ServerTicks, uint16 ChunkIndex, uint16 NumKartsInChunk }
+*           then, for chunks, the snapshot chunk as returned by FGoKartSnapshot::GetCompressedChunk,
+*           or, for hellos and cookies, a cookie of CookieSize bytes.
+*
+*/
+namespace GoKartSpectator
+{
+	const uint32 Magic = 0x50534B47; // 'GKSP'
+
+	// Largest datagram we send or expect, comfortably under a typical MTU.
+	const int32 MaxDatagramSize = 1200;
+
+	// Seconds without a hello before the relay forgets a spectator. Spectators resend it well within this.
+	const float SpectatorTimeout = 10.f;
+	const float HelloInterval = 2.f;
+
+	// Cookies are valid for between one and two of these (s).
+	const float CookieLifetime = 10.f;
+	const int32 CookieSize = 8;
+
+	enum class EDatagramType : uint8
+	{
+		// A chunk of the kart snapshot, server to relay to spectators.
+		Chunk,
+		// Spectator to relay: start or keep sending me the stream. Echoes the last cookie, zeros before the first.
+		Hello,
+		// Relay to spectator: answer to a hello without a valid cookie, with the cookie to echo.
+		Cookie,
+	};
+
+	struct FDatagramHeader
+	{
+		EDatagramType Type = EDatagramType::Chunk;
+		uint32 Frame = 0;
+		int64 ServerTicks = 0;
+		uint16 ChunkIndex = 0;
+		uint16 NumKartsInChunk = 0;
+	};
+
+	NETWORKRACERS_API void WriteDatagram(TArray<uint8>& OutDatagram, const FDatagramHeader& Header, const TArray<uint8>& Payload);
+
+	// False if Data isn't a spectator stream datagram. OutPayload is the rest of the datagram.
+	NETWORKRACERS_API bool ReadDatagram(const uint8* Data, int32 Size, FDatagramHeader& OutHeader, TArray<uint8>& OutPayload);
+
+	// Non-blocking UDP socket, bound to Port (0 for any).
+	NETWORKRACERS_API FSocket* CreateSocket(const FString& Description, int32 Port);
+	NETWORKRACERS_API void DestroySocket(FSocket*& Socket);
+
+	// Parse "host:port", eg. 127.0.0.1:7788 or relay.example.com:7788. Host names are resolved with a blocking lookup.
+	NETWORKRACERS_API TSharedPtr<FInternetAddr> ParseAddress(const FString& Address);
+}
+
+/**
+* Server side of the spectator stream. Sends every chunk of the kart snapshot to the relay once per call to Broadcast.
+*
+*/
+class NETWORKRACERS_API FGoKartSpectatorBroadcaster
+{
+public:
+	FGoKartSpectatorBroadcaster();
+	~FGoKartSpectatorBroadcaster();
+
+	bool Start(const FString& RelayAddress);
+	void Stop();
+
+	void Broadcast(FGoKartSnapshot& Snapshot, int64 ServerTicks);
+
+	bool IsRunning() const { return Socket != nullptr; };
+
+private:
+	FSocket* Socket;
+	TSharedPtr<FInternetAddr> Relay;
+	uint32 NextFrame;
+
+	TArray<uint8> Datagram;
+
+};
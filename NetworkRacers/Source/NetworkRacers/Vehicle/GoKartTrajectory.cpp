@@ -0,0 +1,293 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartTrajectory.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/MemoryReader.h"
+
+
+namespace GoKartTrajectory
+{
+	// Location is stored in mm, velocity in cm/s.
+	const float LocationScale = 10.f;
+	const float VelocityScale = 100.f;
+
+	// Components of a quantized sample: location xyz, pitch/yaw/roll, velocity xyz.
+	const int32 NumComponents = 9;
+	const int32 FirstRotationComponent = 3;
+	const int32 LastRotationComponent = 5;
+
+	// Sanity limit on a chunk read back from disk.
+	const uint32 MaxPayloadSize = 64 * 1024;
+
+	FString GetTrajectoryPath(const FString& Name)
+	{
+		return FPaths::ProjectSavedDir() / TEXT("Trajectories") / (Name + TEXT(".gktraj"));
+
+	}
+
+	void Quantize(const FGoKartObserverState& Sample, int32* OutQuantized)
+	{
+		OutQuantized[0] = FMath::RoundToInt(Sample.Location.X * LocationScale);
+		OutQuantized[1] = FMath::RoundToInt(Sample.Location.Y * LocationScale);
+		OutQuantized[2] = FMath::RoundToInt(Sample.Location.Z * LocationScale);
+		OutQuantized[3] = FRotator::CompressAxisToShort(Sample.Rotation.Pitch);
+		OutQuantized[4] = FRotator::CompressAxisToShort(Sample.Rotation.Yaw);
+		OutQuantized[5] = FRotator::CompressAxisToShort(Sample.Rotation.Roll);
+		OutQuantized[6] = FMath::RoundToInt(Sample.Velocity.X * VelocityScale);
+		OutQuantized[7] = FMath::RoundToInt(Sample.Velocity.Y * VelocityScale);
+		OutQuantized[8] = FMath::RoundToInt(Sample.Velocity.Z * VelocityScale);
+
+	}
+
+	FGoKartObserverState Dequantize(const int32* Quantized)
+	{
+		FGoKartObserverState Sample;
+		Sample.Location = FVector(Quantized[0], Quantized[1], Quantized[2]) / LocationScale;
+		Sample.Rotation = FRotator(FRotator::DecompressAxisFromShort(Quantized[3]), FRotator::DecompressAxisFromShort(Quantized[4]), FRotator::DecompressAxisFromShort(Quantized[5]));
+		Sample.Velocity = FVector(Quantized[6], Quantized[7], Quantized[8]) / VelocityScale;
+		return Sample;
+
+	}
+
+	/**
+	* Zigzag maps small magnitudes of either sign to small unsigned values (0, -1, 1, -2 -> 0, 1, 2, 3),
+	* and the varint then stores 7 bits per byte, so small deltas take a single byte.
+	*
+	*/
+	void WriteVarInt(TArray<uint8>& Out, int32 Value)
+	{
+		uint32 ZigZag = (static_cast<uint32>(Value) << 1) ^ static_cast<uint32>(Value >> 31);
+		while (ZigZag >= 0x80)
+		{
+			Out.Add(static_cast<uint8>(ZigZag | 0x80));
+			ZigZag >>= 7;
+
+		}
+		Out.Add(static_cast<uint8>(ZigZag));
+
+	}
+
+	bool ReadVarInt(const TArray<uint8>& In, int32& Offset, int32& OutValue)
+	{
+		uint32 ZigZag = 0;
+		for (int32 Shift = 0; Shift < 35; Shift += 7)
+		{
+			if (Offset >= In.Num()) return false;
+
+			const uint8 Byte = In[Offset++];
+			ZigZag |= static_cast<uint32>(Byte & 0x7F) << Shift;
+			if ((Byte & 0x80) == 0)
+			{
+				OutValue = static_cast<int32>(ZigZag >> 1) ^ -static_cast<int32>(ZigZag & 1);
+				return true;
+
+			}
+
+		}
+
+		return false;
+
+	}
+
+	// Rotations wrap, so their deltas are taken modulo 2^16 to stay small across the +-180 seam.
+	int32 Delta(int32 Component, int32 Value, int32 Prev)
+	{
+		const bool bRotation = Component >= FirstRotationComponent && Component <= LastRotationComponent;
+		return bRotation ? static_cast<int16>(static_cast<uint16>(Value - Prev)) : Value - Prev;
+
+	}
+
+	int32 ApplyDelta(int32 Component, int32 DeltaValue, int32 Prev)
+	{
+		const bool bRotation = Component >= FirstRotationComponent && Component <= LastRotationComponent;
+		return bRotation ? static_cast<uint16>(Prev + DeltaValue) : Prev + DeltaValue;
+
+	}
+}
+
+FGoKartTrajectoryWriter::FGoKartTrajectoryWriter()
+	: FileHandle(nullptr)
+	, SamplesPerChunk(64)
+	, NumChunkSamples(0)
+{
+	FMemory::Memzero(PrevQuantized);
+
+}
+
+FGoKartTrajectoryWriter::~FGoKartTrajectoryWriter()
+{
+	Close();
+
+}
+
+bool FGoKartTrajectoryWriter::Open(const FString& Filename, float SampleRate, int32 InSamplesPerChunk)
+{
+	Close();
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+	FileHandle = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Filename);
+	if (FileHandle == nullptr) return false;
+
+	SamplesPerChunk = FMath::Clamp(InSamplesPerChunk, 1, (int32)MAX_uint16);
+	NumChunkSamples = 0;
+	ChunkPayload.Reset();
+
+	TArray<uint8> Header;
+	FMemoryWriter Writer(Header);
+	uint32 Magic = GoKartTrajectory::Magic;
+	uint16 Version = GoKartTrajectory::Version;
+	uint16 ChunkSize = SamplesPerChunk;
+	Writer << Magic << Version << SampleRate << ChunkSize;
+
+	return FileHandle->Write(Header.GetData(), Header.Num());
+
+}
+
+void FGoKartTrajectoryWriter::AddSample(const FGoKartObserverState& Sample)
+{
+	if (FileHandle == nullptr) return;
+
+	int32 Quantized[GoKartTrajectory::NumComponents];
+	GoKartTrajectory::Quantize(Sample, Quantized);
+
+	const bool bKeyframe = NumChunkSamples == 0;
+	for (int32 Component = 0; Component < GoKartTrajectory::NumComponents; ++Component)
+	{
+		const int32 Value = bKeyframe ? Quantized[Component] : GoKartTrajectory::Delta(Component, Quantized[Component], PrevQuantized[Component]);
+		GoKartTrajectory::WriteVarInt(ChunkPayload, Value);
+		PrevQuantized[Component] = Quantized[Component];
+
+	}
+
+	if (++NumChunkSamples >= SamplesPerChunk)
+	{
+		FlushChunk();
+
+	}
+
+}
+
+void FGoKartTrajectoryWriter::FlushChunk()
+{
+	if (FileHandle == nullptr || NumChunkSamples == 0) return;
+
+	TArray<uint8> ChunkHeader;
+	FMemoryWriter Writer(ChunkHeader);
+	uint16 NumSamples = NumChunkSamples;
+	uint32 PayloadSize = ChunkPayload.Num();
+	Writer << NumSamples << PayloadSize;
+
+	FileHandle->Write(ChunkHeader.GetData(), ChunkHeader.Num());
+	FileHandle->Write(ChunkPayload.GetData(), ChunkPayload.Num());
+
+	ChunkPayload.Reset();
+	NumChunkSamples = 0;
+
+}
+
+void FGoKartTrajectoryWriter::Close()
+{
+	if (FileHandle == nullptr) return;
+
+	FlushChunk();
+	delete FileHandle;
+	FileHandle = nullptr;
+
+}
+
+FGoKartTrajectoryReader::FGoKartTrajectoryReader()
+	: FileHandle(nullptr)
+	, SampleRate(0.f)
+{
+
+}
+
+FGoKartTrajectoryReader::~FGoKartTrajectoryReader()
+{
+	Close();
+
+}
+
+bool FGoKartTrajectoryReader::Open(const FString& Filename)
+{
+	Close();
+
+	FileHandle = FPlatformFileManager::Get().GetPlatformFile().OpenRead(*Filename);
+	if (FileHandle == nullptr) return false;
+
+	uint8 HeaderBytes[sizeof(uint32) + sizeof(uint16) + sizeof(float) + sizeof(uint16)];
+	if (!FileHandle->Read(HeaderBytes, sizeof(HeaderBytes)))
+	{
+		Close();
+		return false;
+
+	}
+
+	TArray<uint8> Header(HeaderBytes, sizeof(HeaderBytes));
+	FMemoryReader Reader(Header);
+	uint32 Magic;
+	uint16 Version;
+	uint16 SamplesPerChunk;
+	Reader << Magic << Version << SampleRate << SamplesPerChunk;
+
+	if (Magic != GoKartTrajectory::Magic || Version != GoKartTrajectory::Version || SampleRate <= 0.f)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s is not a kart trajectory."), *Filename);
+		Close();
+		return false;
+
+	}
+
+	return true;
+
+}
+
+void FGoKartTrajectoryReader::Close()
+{
+	delete FileHandle;
+	FileHandle = nullptr;
+
+}
+
+bool FGoKartTrajectoryReader::ReadChunk(TArray<FGoKartObserverState>& OutSamples)
+{
+	OutSamples.Reset();
+	if (FileHandle == nullptr) return false;
+
+	uint8 ChunkHeaderBytes[sizeof(uint16) + sizeof(uint32)];
+	if (!FileHandle->Read(ChunkHeaderBytes, sizeof(ChunkHeaderBytes))) return false;
+
+	TArray<uint8> ChunkHeader(ChunkHeaderBytes, sizeof(ChunkHeaderBytes));
+	FMemoryReader Reader(ChunkHeader);
+	uint16 NumSamples;
+	uint32 PayloadSize;
+	Reader << NumSamples << PayloadSize;
+
+	if (PayloadSize > GoKartTrajectory::MaxPayloadSize) return false;
+
+	ChunkPayload.SetNumUninitialized(PayloadSize, false);
+	if (!FileHandle->Read(ChunkPayload.GetData(), PayloadSize)) return false;
+
+	int32 Offset = 0;
+	int32 Quantized[GoKartTrajectory::NumComponents];
+	OutSamples.Reserve(NumSamples);
+	for (int32 SampleIndex = 0; SampleIndex < NumSamples; ++SampleIndex)
+	{
+		for (int32 Component = 0; Component < GoKartTrajectory::NumComponents; ++Component)
+		{
+			int32 Value;
+			if (!GoKartTrajectory::ReadVarInt(ChunkPayload, Offset, Value)) return false;
+
+			Quantized[Component] = SampleIndex == 0 ? Value : GoKartTrajectory::ApplyDelta(Component, Value, Quantized[Component]);
+
+		}
+		OutSamples.Add(GoKartTrajectory::Dequantize(Quantized));
+
+	}
+
+	return true;
+
+}
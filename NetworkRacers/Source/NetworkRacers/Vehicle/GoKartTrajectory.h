@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GoKartMovementReplicator.h"
+
+class IFileHandle;
+
+
+/**
+* Compact on-disk kart trajectory, for time-trial ghosts and race replays.
+*
+* A trajectory is the kart's observer state sampled at a fixed rate. Samples are quantized like FGoKartSnapshot
+* records (location to 1 mm, rotation to 16 bits per axis, velocity to 1 cm/s) and grouped into chunks. The first
+* sample of a chunk is a keyframe stored whole; the rest are stored as the change from the previous sample.
+* Every value is zigzag varint encoded, so a kart cruising along costs a couple of bytes per component.
+*
+* Chunks decode independently, so a file can be written as it is recorded and read back a chunk at a time.
+*
+* File: header { uint32 Magic, uint16 Version, float SampleRate, uint16 SamplesPerChunk }
+*       then chunks { uint16 NumSamples, uint32 PayloadSize, payload }
+*
+*/
+namespace GoKartTrajectory
+{
+	const uint32 Magic = 0x52544B47; // 'GKTR'
+	const uint16 Version = 1;
+
+	// Where trajectories are recorded, eg. Saved/Trajectories/<Name>.gktraj
+	NETWORKRACERS_API FString GetTrajectoryPath(const FString& Name);
+}
+
+class NETWORKRACERS_API FGoKartTrajectoryWriter
+{
+public:
+	FGoKartTrajectoryWriter();
+	~FGoKartTrajectoryWriter();
+
+	bool Open(const FString& Filename, float SampleRate, int32 SamplesPerChunk = 64);
+
+	void AddSample(const FGoKartObserverState& Sample);
+
+	// Write the partial chunk, if any, and close the file.
+	void Close();
+
+	bool IsOpen() const { return FileHandle != nullptr; };
+
+private:
+	void FlushChunk();
+
+	IFileHandle* FileHandle;
+	int32 SamplesPerChunk;
+
+	TArray<uint8> ChunkPayload;
+	int32 NumChunkSamples;
+	int32 PrevQuantized[9];
+
+};
+
+class NETWORKRACERS_API FGoKartTrajectoryReader
+{
+public:
+	FGoKartTrajectoryReader();
+	~FGoKartTrajectoryReader();
+
+	bool Open(const FString& Filename);
+
+	void Close();
+
+	// Decode the next chunk into OutSamples, replacing its contents. False at the end of the file or on a bad chunk.
+	bool ReadChunk(TArray<FGoKartObserverState>& OutSamples);
+
+	float GetSampleRate() const { return SampleRate; };
+
+	bool IsOpen() const { return FileHandle != nullptr; };
+
+private:
+	IFileHandle* FileHandle;
+	float SampleRate;
+
+	// Reused between chunks so reading doesn't allocate once warmed up.
+	TArray<uint8> ChunkPayload;
+
+};
@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartTrajectoryRecorder.h"
+#include "GoKartSimulation.h"
+#include "GameFramework/Actor.h"
+
+
+UGoKartTrajectoryRecorder::UGoKartTrajectoryRecorder()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+
+	TimeSinceSample = 0.f;
+	MovementComponent = nullptr;
+
+}
+
+void UGoKartTrajectoryRecorder::BeginPlay()
+{
+	Super::BeginPlay();
+
+	TArray<UActorComponent*> MovementComponents = GetOwner()->GetComponentsByInterface(UGoKartMovementInterface::StaticClass());
+	if (MovementComponents.Num() > 0)
+	{
+		MovementComponent = Cast<IGoKartMovementInterface>(MovementComponents[0]);
+
+		// Record the move the movement component made this frame.
+		PrimaryComponentTick.AddPrerequisite(MovementComponents[0], MovementComponents[0]->PrimaryComponentTick);
+
+	}
+
+}
+
+void UGoKartTrajectoryRecorder::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	StopRecording();
+
+	Super::EndPlay(EndPlayReason);
+
+}
+
+bool UGoKartTrajectoryRecorder::StartRecording(const FString& Name)
+{
+	if (SampleRate <= 0.f || !Writer.Open(GoKartTrajectory::GetTrajectoryPath(Name), SampleRate)) return false;
+
+	InputTrace.Reset();
+	InputTracePath = GoKartInputTrace::GetInputTracePath(Name);
+
+	// The first sample is where the kart is now.
+	TimeSinceSample = 0.f;
+	RecordSample();
+	SetComponentTickEnabled(true);
+	return true;
+
+}
+
+void UGoKartTrajectoryRecorder::StopRecording()
+{
+	if (Writer.IsOpen() && InputTrace.Num() > 0)
+	{
+		GoKartInputTrace::Save(InputTracePath, InputTrace);
+
+	}
+	InputTrace.Empty();
+
+	Writer.Close();
+	SetComponentTickEnabled(false);
+
+}
+
+void UGoKartTrajectoryRecorder::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	// Only the driving machine builds moves from input, elsewhere there are none to record.
+	if (MovementComponent != nullptr)
+	{
+		// Traces hold single steps, so a move standing for several is recorded once for each.
+		FGoKartMove Move = MovementComponent->GetPrevMove();
+		const int32 NumSteps = Move.Steps;
+		Move.Steps = 1;
+		for (int32 StepIndex = 0; StepIndex < NumSteps && Move.DeltaTime > 0.f; ++StepIndex)
+		{
+			InputTrace.Add(Move);
+
+		}
+
+	}
+
+	// Fixed-rate samples, so playback can find any sample from the time alone. Frame hitches repeat the latest state.
+	const float SampleInterval = 1.f / SampleRate;
+	TimeSinceSample += DeltaTime;
+	while (TimeSinceSample >= SampleInterval)
+	{
+		RecordSample();
+		TimeSinceSample -= SampleInterval;
+
+	}
+
+}
+
+void UGoKartTrajectoryRecorder::RecordSample()
+{
+	FGoKartObserverState Sample;
+	Sample.Location = GetOwner()->GetActorLocation();
+	Sample.Rotation = GetOwner()->GetActorRotation();
+	Sample.Velocity = MovementComponent != nullptr ? MovementComponent->GetVelocity() : FVector::ZeroVector;
+
+	Writer.AddSample(Sample);
+
+}
@@ -0,0 +1,62 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "GoKartTrajectory.h"
+#include "GoKartTrajectoryRecorder.generated.h"
+
+class IGoKartMovementInterface;
+
+
+/**
+* Records the owning kart's trajectory to disk at a fixed rate, eg. for a time-trial ghost.
+* Samples are written a chunk at a time as the race goes, so a recording never holds more than one chunk in memory.
+*
+* On the machine driving the kart, the moves it simulates are recorded as well and saved as an input trace when
+* recording stops, for UGoKartTuningCommandlet to replay.
+*
+*/
+UCLASS( ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class NETWORKRACERS_API UGoKartTrajectoryRecorder : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:	
+	UGoKartTrajectoryRecorder();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	// Start recording to Saved/Trajectories/<Name>.gktraj (and <Name>.csv), replacing any recording of that name.
+	UFUNCTION(BlueprintCallable, Category = "Trajectory")
+	bool StartRecording(const FString& Name);
+
+	UFUNCTION(BlueprintCallable, Category = "Trajectory")
+	void StopRecording();
+
+	UFUNCTION(BlueprintPure, Category = "Trajectory")
+	bool IsRecording() const { return Writer.IsOpen(); };
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	// Samples recorded per second.
+	UPROPERTY(EditAnywhere, Category = "Trajectory")
+	float SampleRate = 20.f;
+
+private:
+	void RecordSample();
+
+	FGoKartTrajectoryWriter Writer;
+
+	TArray<FGoKartMove> InputTrace;
+	FString InputTracePath;
+
+	float TimeSinceSample;
+
+	IGoKartMovementInterface* MovementComponent;
+
+};
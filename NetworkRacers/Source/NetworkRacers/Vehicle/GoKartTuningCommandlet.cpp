@@ -0,0 +1,269 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GoKartTuningCommandlet.h"
+#include "GoKartMovementComponent.h"
+#include "GoKartSimulation.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "PhysicsEngine/PhysicsSettings.h"
+
+
+namespace GoKartTuning
+{
+	struct FTrace
+	{
+		FString Name;
+		TArray<FGoKartMove> Moves;
+		// Distance the default tuning covers over the trace (m).
+		float LapDistance;
+	};
+
+	struct FRunResult
+	{
+		// s, or negative if the lap distance was never reached.
+		float LapTime = -1.f;
+		// m/s
+		float TopSpeed = 0.f;
+		// deg/s
+		float PeakYawRate = 0.f;
+		// g
+		float PeakLateralAcceleration = 0.f;
+		// m
+		float Distance = 0.f;
+	};
+
+	FRunResult Run(GoKartSimulation::FKernel Kernel, const FTrace& Trace, const FGoKartTuning& Tuning, float GravityZ, float LapDistance)
+	{
+		FRunResult Result;
+		FGoKartSimState State;
+		float Time = 0.f;
+
+		for (const FGoKartMove& Move : Trace.Moves)
+		{
+			const FGoKartSimState Before = State;
+			Kernel(State, Move, Tuning, GravityZ);
+			if (Move.DeltaTime <= 0.f) continue;
+
+			const float StepDistance = FVector::Dist(Before.Location, State.Location) / 100.f;
+			if (Result.LapTime < 0.f && LapDistance > 0.f && Result.Distance + StepDistance >= LapDistance)
+			{
+				Result.LapTime = Time + Move.DeltaTime * (LapDistance - Result.Distance) / StepDistance;
+
+			}
+			Result.Distance += StepDistance;
+			Time += Move.DeltaTime;
+
+			const float Speed = State.Velocity.Size();
+			const float YawRate = FMath::RadiansToDegrees(Before.Rotation.AngularDistance(State.Rotation)) / Move.DeltaTime;
+			Result.TopSpeed = FMath::Max(Result.TopSpeed, Speed);
+			Result.PeakYawRate = FMath::Max(Result.PeakYawRate, YawRate);
+			Result.PeakLateralAcceleration = FMath::Max(Result.PeakLateralAcceleration, Speed * FMath::DegreesToRadians(YawRate) * 100.f / -GravityZ);
+
+		}
+
+		return Result;
+
+	}
+
+	// Comma separated values of Name= on the command line, or just Default.
+	TArray<float> ParseValues(const FString& Params, const TCHAR* Name, float Default)
+	{
+		TArray<float> Values;
+		FString List;
+		if (FParse::Value(*Params, *FString::Printf(TEXT("%s="), Name), List, false))
+		{
+			TArray<FString> Items;
+			List.ParseIntoArray(Items, TEXT(","));
+			for (const FString& Item : Items)
+			{
+				if (Item.IsNumeric()) Values.Add(FCString::Atof(*Item));
+
+			}
+
+		}
+		if (Values.Num() == 0) Values.Add(Default);
+
+		return Values;
+
+	}
+}
+
+UGoKartTuningCommandlet::UGoKartTuningCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+
+}
+
+int32 UGoKartTuningCommandlet::Main(const FString& Params)
+{
+	using namespace GoKartTuning;
+
+	const FGoKartTuning DefaultTuning = GetDefault<UGoKartMovementComponent>()->GetTuning();
+	float GravityZ = UPhysicsSettings::Get()->DefaultGravityZ;
+	FParse::Value(*Params, TEXT("GravityZ="), GravityZ);
+
+	EGoKartVehicleClass VehicleClass = GetDefault<UGoKartMovementComponent>()->GetVehicleClass();
+	FString VehicleClassName;
+	if (FParse::Value(*Params, TEXT("VehicleClass="), VehicleClassName))
+	{
+		const UEnum* VehicleClassEnum = FindObject<UEnum>(ANY_PACKAGE, TEXT("EGoKartVehicleClass"));
+		const int64 Value = VehicleClassEnum != nullptr ? VehicleClassEnum->GetValueByNameString(VehicleClassName) : INDEX_NONE;
+		if (Value == INDEX_NONE)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Unknown vehicle class %s."), *VehicleClassName);
+			return 1;
+
+		}
+		VehicleClass = static_cast<EGoKartVehicleClass>(Value);
+
+	}
+	const GoKartSimulation::FKernel Kernel = GoKartSimulation::GetKernel(VehicleClass);
+
+	// Every trace to replay.
+	TArray<FString> TraceFiles;
+	FString TraceList;
+	if (FParse::Value(*Params, TEXT("Traces="), TraceList, false))
+	{
+		TraceList.ParseIntoArray(TraceFiles, TEXT(","));
+
+	}
+	else
+	{
+		const FString TraceDirectory = FPaths::GetPath(GoKartInputTrace::GetInputTracePath(TEXT("")));
+		IFileManager::Get().FindFiles(TraceFiles, *(TraceDirectory / TEXT("*.csv")), true, false);
+		for (FString& TraceFile : TraceFiles)
+		{
+			TraceFile = TraceDirectory / TraceFile;
+
+		}
+
+	}
+
+	TArray<FTrace> Traces;
+	for (const FString& TraceFile : TraceFiles)
+	{
+		FTrace Trace;
+		Trace.Name = FPaths::GetBaseFilename(TraceFile);
+		if (!GoKartInputTrace::Load(TraceFile, Trace.Moves))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Skipping %s, not an input trace."), *TraceFile);
+			continue;
+
+		}
+		Trace.LapDistance = 0.f;
+		Traces.Add(MoveTemp(Trace));
+
+	}
+	if (Traces.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("No input traces to replay. Record some with UGoKartTrajectoryRecorder or pass -Traces=."));
+		return 1;
+
+	}
+
+	// The lap is however far the current handling gets on each trace.
+	ParallelFor(Traces.Num(), [&Traces, &DefaultTuning, Kernel, GravityZ](int32 TraceIndex)
+	{
+		Traces[TraceIndex].LapDistance = Run(Kernel, Traces[TraceIndex], DefaultTuning, GravityZ, 0.f).Distance;
+	});
+
+	// Grid of tuning values, enumerated as a mixed-radix number with Mass varying fastest.
+	const TArray<float> Axes[] =
+	{
+		ParseValues(Params, TEXT("Mass"), DefaultTuning.Mass),
+		ParseValues(Params, TEXT("MaxDrivingForce"), DefaultTuning.MaxDrivingForce),
+		ParseValues(Params, TEXT("MinTurningRadius"), DefaultTuning.MinTurningRadius),
+		ParseValues(Params, TEXT("DragCoefficient"), DefaultTuning.DragCoefficient),
+		ParseValues(Params, TEXT("RollingResistanceCoefficient"), DefaultTuning.RollingResistanceCoefficient),
+	};
+
+	TArray<FGoKartTuning> Grid;
+	int32 NumCombinations = 1;
+	for (const TArray<float>& Axis : Axes)
+	{
+		NumCombinations *= Axis.Num();
+
+	}
+	Grid.Reserve(NumCombinations);
+	for (int32 Combination = 0; Combination < NumCombinations; ++Combination)
+	{
+		int32 Index[ARRAY_COUNT(Axes)];
+		int32 Remainder = Combination;
+		for (int32 Axis = 0; Axis < ARRAY_COUNT(Axes); ++Axis)
+		{
+			Index[Axis] = Remainder % Axes[Axis].Num();
+			Remainder /= Axes[Axis].Num();
+
+		}
+
+		FGoKartTuning Tuning;
+		Tuning.Mass = Axes[0][Index[0]];
+		Tuning.MaxDrivingForce = Axes[1][Index[1]];
+		Tuning.MinTurningRadius = Axes[2][Index[2]];
+		Tuning.DragCoefficient = Axes[3][Index[3]];
+		Tuning.RollingResistanceCoefficient = Axes[4][Index[4]];
+		Grid.Add(Tuning);
+
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Sweeping %d tuning combinations over %d traces."), Grid.Num(), Traces.Num());
+
+	// Runs share nothing but read-only inputs, so each writes its own result slot.
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<FRunResult> Results;
+	Results.SetNum(Grid.Num() * Traces.Num());
+	ParallelFor(Results.Num(), [&Results, &Grid, &Traces, Kernel, GravityZ](int32 RunIndex)
+	{
+		const FTrace& Trace = Traces[RunIndex % Traces.Num()];
+		Results[RunIndex] = Run(Kernel, Trace, Grid[RunIndex / Traces.Num()], GravityZ, Trace.LapDistance);
+	});
+	const double WallTime = FPlatformTime::Seconds() - StartTime;
+
+	double SimulatedTime = 0.0;
+	for (const FTrace& Trace : Traces)
+	{
+		for (const FGoKartMove& Move : Trace.Moves)
+		{
+			SimulatedTime += Move.DeltaTime;
+
+		}
+
+	}
+	SimulatedTime *= Grid.Num();
+	UE_LOG(LogTemp, Display, TEXT("Simulated %.0f s of driving in %.2f s (%.0fx real time)."), SimulatedTime, WallTime, SimulatedTime / FMath::Max(WallTime, 1e-6));
+
+	FString Csv = TEXT("Trace,Mass,MaxDrivingForce,MinTurningRadius,DragCoefficient,RollingResistanceCoefficient,LapTime,TopSpeed,PeakYawRate,PeakLateralAcceleration\n");
+	for (int32 RunIndex = 0; RunIndex < Results.Num(); ++RunIndex)
+	{
+		const FTrace& Trace = Traces[RunIndex % Traces.Num()];
+		const FGoKartTuning& Tuning = Grid[RunIndex / Traces.Num()];
+		const FRunResult& Result = Results[RunIndex];
+		const FString LapTime = Result.LapTime >= 0.f ? FString::Printf(TEXT("%.3f"), Result.LapTime) : FString();
+
+		Csv += FString::Printf(TEXT("%s,%g,%g,%g,%g,%g,%s,%.2f,%.1f,%.3f\n"), *Trace.Name,
+			Tuning.Mass, Tuning.MaxDrivingForce, Tuning.MinTurningRadius, Tuning.DragCoefficient, Tuning.RollingResistanceCoefficient,
+			*LapTime, Result.TopSpeed, Result.PeakYawRate, Result.PeakLateralAcceleration);
+
+	}
+
+	FString Output = FPaths::ProjectSavedDir() / TEXT("Tuning") / FString::Printf(TEXT("Sweep_%s.csv"), *FDateTime::Now().ToString());
+	FParse::Value(*Params, TEXT("Output="), Output);
+	if (!FFileHelper::SaveStringToFile(Csv, *Output))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Couldn't write %s."), *Output);
+		return 1;
+
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote %s."), *Output);
+	return 0;
+
+}
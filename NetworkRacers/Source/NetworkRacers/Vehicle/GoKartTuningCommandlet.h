@@ -0,0 +1,37 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "GoKartTuningCommandlet.generated.h"
+
+
+/**
+* Handling sweep: replays recorded input traces (see UGoKartTrajectoryRecorder) with every combination of a grid of
+* tuning values, on all cores and as fast as they will go, and writes how each one drove to CSV.
+*
+*	UE4Editor-Cmd NetworkRacers -run=GoKartTuning -Mass=800,1000,1200 -MaxDrivingForce=8000,10000 -Traces=Lap1.csv,Lap2.csv
+*
+* Grid: -Mass= -MaxDrivingForce= -MinTurningRadius= -DragCoefficient= -RollingResistanceCoefficient=, each a comma
+* separated list of values. Anything not given stays at UGoKartMovementComponent's default.
+* Traces: -Traces= list of files, by default every input trace in Saved/Trajectories/.
+* Vehicle class: -VehicleClass= one of EGoKartVehicleClass, by default UGoKartMovementComponent's.
+* Output: -Output= file, by default Saved/Tuning/Sweep_<date>.csv.
+*
+* Runs happen on an open plane, so lap time is the time taken to cover the distance the default tuning covers over
+* the whole trace, left empty if the combination never gets that far. Stability is given as peak yaw rate (deg/s)
+* and peak lateral acceleration (g).
+*
+*/
+UCLASS()
+class UGoKartTuningCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UGoKartTuningCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+};